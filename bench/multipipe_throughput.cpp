@@ -0,0 +1,92 @@
+// Throughput of multipipe::listen() with newline checking on.
+//
+// Text made of fixed length lines is written into a FIFO that a multipipe
+// reads. "forward" passes it on to /dev/null the way a stream shared by
+// two runners is (lines are kept whole, no splicing), "messages" hands
+// every line to a custom handler the way controller and agent traffic is.
+//
+// usage: bench_multipipe [megabytes]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "multipipe.h"
+
+static void write_lines(const std::string &fifo, size_t line_length, size_t total)
+{
+    std::string block;
+    while (block.size() < 1024 * 1024) {
+        block.append(line_length - 1, 'x');
+        block.push_back('\n');
+    }
+
+    int fd = open(fifo.c_str(), O_WRONLY);
+    if (fd == -1) {
+        perror(fifo.c_str());
+        exit(EXIT_FAILURE);
+    }
+    for (size_t written = 0; written < total;) {
+        auto len = write(fd, block.data(), block.size());
+        if (len <= 0)
+            break;
+        written += len;
+    }
+    close(fd);
+}
+
+static double measure(const std::string &fifo, size_t line_length, size_t total, bool messages)
+{
+    std::thread writer(write_lines, fifo, line_length, total);
+    auto source = multipipe::open_file(fifo);
+
+    multipipe_ptr sink, other_source;
+    volatile size_t received = 0;
+    if (messages) {
+        source->set_custom_process_message([&](const char *, size_t count) { received += count; });
+    } else {
+        // a second parent makes the source keep lines whole
+        sink = multipipe::create_file("/dev/null");
+        other_source = multipipe::create_pipe(write_mode);
+        other_source->connect(sink);
+        source->connect(sink);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    source->start_read();
+    writer.join();
+    source->finalize();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return total / seconds / (1024 * 1024);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 256;
+    size_t total = megabytes * 1024 * 1024;
+
+    std::string fifo = "/tmp/bench_multipipe." + std::to_string(getpid());
+    if (mkfifo(fifo.c_str(), 0600) == -1) {
+        perror(fifo.c_str());
+        return EXIT_FAILURE;
+    }
+
+    printf("megabytes:    %zu\n", megabytes);
+    printf("line  forward     messages\n");
+    for (size_t line_length : { 16, 80, 1024 }) {
+        double forward = measure(fifo, line_length, total, false);
+        double messages = measure(fifo, line_length, total, true);
+        printf("%-5zu %6.0f MB/s %6.0f MB/s\n", line_length, forward, messages);
+    }
+
+    unlink(fifo.c_str());
+    return 0;
+}
@@ -0,0 +1,111 @@
+// Cost of one monitor tick worth of /proc sampling for a single runner.
+//
+// "legacy" is the sampling procfs_class did before it kept its
+// descriptors open: open()/read()/close() of io and stat plus a
+// strstr()/strsep()/strtoull() parse. "procfs_class" is the current
+// implementation.
+//
+// usage: bench_procfs [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "linux_procfs.h"
+
+static volatile size_t sink;
+
+static bool legacy_fill(const std::string &io_path, const std::string &stat_path)
+{
+    char buffer[4096], *token = buffer, *needle;
+    size_t utime = 0, stime = 0, vsize = 0, rss = 0;
+    int fd, len, index = 0;
+
+    fd = open(io_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (len <= 0)
+        return false;
+    buffer[len] = '\0';
+    needle = strstr(buffer, IO_WR_STR);
+    if (needle == nullptr)
+        return false;
+    sink = strtoull(needle + strlen(IO_WR_STR), nullptr, 10);
+
+    fd = open(stat_path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (len <= 0)
+        return false;
+    buffer[len] = '\0';
+    do {
+        switch (index++) {
+        case STAT_UTIME_POS: utime = strtoull(token, nullptr, 10); break;
+        case STAT_STIME_POS: stime = strtoull(token, nullptr, 10); break;
+        case STAT_VSIZE_POS: vsize = strtoull(token, nullptr, 10); break;
+        case STAT_RSS_POS:   rss = strtoull(token, nullptr, 10); break;
+        default: break;
+        }
+    } while ((strsep(&token, " ") != nullptr) || (index <= STAT_LAST));
+    sink = utime + stime + vsize + rss;
+    return true;
+}
+
+template<typename F>
+static double measure(int iterations, F fill)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        if (!fill()) {
+            fprintf(stderr, "sampling failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+
+    pid_t child = fork();
+    if (child == 0) {
+        pause();
+        _exit(0);
+    }
+
+    std::string pid = std::to_string(child);
+    std::string io_path = "/proc/" + pid + "/io";
+    std::string stat_path = "/proc/" + pid + "/stat";
+
+    procfs_class proc;
+    proc.probe_pid(child);
+
+    // warm up the dentry cache for both variants
+    measure(iterations / 10 + 1, [&]() { return legacy_fill(io_path, stat_path); });
+    measure(iterations / 10 + 1, [&]() { return proc.fill_all(); });
+
+    double legacy = measure(iterations, [&]() { return legacy_fill(io_path, stat_path); });
+    double current = measure(iterations, [&]() { return proc.fill_all(); });
+
+    printf("iterations:   %d\n", iterations);
+    printf("legacy:       %.0f ns/tick\n", legacy);
+    printf("procfs_class: %.0f ns/tick\n", current);
+    printf("speedup:      %.2fx\n", legacy / current);
+
+    kill(child, SIGKILL);
+    waitpid(child, nullptr, 0);
+    return 0;
+}
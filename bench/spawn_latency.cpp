@@ -0,0 +1,72 @@
+// Latency of runner::create_process() for both spawn engines.
+//
+// Every iteration starts /bin/true and times run_process_async(), which
+// returns once the child is set up and running; the child is reaped
+// outside of the measured interval. The parent's size matters for fork(),
+// so a ballast of the given size is allocated and touched first.
+//
+// Must not be run as root, the runner refuses to start children then.
+//
+// usage: bench_spawn [iterations] [ballast megabytes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "runner.h"
+
+static double percentile(std::vector<double> &samples, double p)
+{
+    size_t index = std::min(samples.size() - 1, (size_t)(p / 100 * samples.size()));
+    std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+    return samples[index];
+}
+
+static std::vector<double> measure(const std::string &engine, int iterations)
+{
+    options_class options(session_class::base_session);
+    options.spawn_engine = engine;
+
+    std::vector<double> samples;
+    for (int i = 0; i < iterations; i++) {
+        runner child("/bin/true", options);
+        child.get_pipe(std_stream_input);
+        child.get_pipe(std_stream_output);
+        child.get_pipe(std_stream_error);
+
+        auto start = std::chrono::steady_clock::now();
+        child.run_process_async();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        samples.push_back(std::chrono::duration<double, std::micro>(elapsed).count());
+
+        child.wait_for();
+    }
+    return samples;
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t ballast_size = (size_t)(argc > 2 ? atoi(argv[2]) : 256) * 1024 * 1024;
+
+    char *ballast = (char *)malloc(ballast_size);
+    memset(ballast, 1, ballast_size);
+
+    printf("iterations:   %d\n", iterations);
+    printf("ballast:      %zu MB\n", ballast_size / (1024 * 1024));
+    printf("engine          p50        p90        p99 (us)\n");
+    for (const char *engine : { "fork", "vfork" }) {
+        auto samples = measure(engine, iterations);
+        double p50 = percentile(samples, 50);
+        double p90 = percentile(samples, 90);
+        double p99 = percentile(samples, 99);
+        printf("%-8s %10.0f %10.0f %10.0f\n", engine, p50, p90, p99);
+    }
+
+    free(ballast);
+    return 0;
+}
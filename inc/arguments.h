@@ -368,6 +368,21 @@ public:
     }
 };
 
+class count_argument_parser_c : public unit_argument_parser_c < restriction_t, unit_no_unit, degree_default > {
+public:
+    count_argument_parser_c(restriction_t &value) : unit_argument_parser_c<restriction_t, unit_no_unit, degree_default>(value) {}
+    virtual bool set(const std::string &s) {
+        if (!unit_argument_parser_c<restriction_t, unit_no_unit, degree_default>::set(s)) {
+            return false;
+        }
+        if (value == 0) {
+            error = "Count cannot be set to 0";
+            return false;
+        }
+        return true;
+    }
+};
+
 template<typename T, bool inverted = false>
 class base_boolean_argument_parser_c : public base_argument_parser_c < T > {
 protected:
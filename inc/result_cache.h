@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include <stdint.h>
+
+#include "inc/stream_digest.h"
+
+// Results of earlier runs, stored under a directory with one subdirectory
+// per key: the report and whatever the run wrote to its stdout and stderr
+// files. The entries used least recently go first once the directory
+// grows past its size limit. POSIX only.
+class result_cache_c {
+public:
+    result_cache_c(const std::string& directory, uint64_t size_limit);
+
+    // writes the outputs of the entry to the given files, empty paths are
+    // skipped; the entry counts as used
+    bool restore(const std::string& key, const std::string& output_path, const std::string& error_path,
+        std::string& report) const;
+    // an entry already stored by someone else is left as it is
+    void store(const std::string& key, const std::string& output_path, const std::string& error_path,
+        const std::string& report) const;
+
+    // adds the length and the contents of the file to a key
+    static bool append_file(stream_digest_class& key, const std::string& path);
+    // adds the length and the string itself, so that neighbours can't run
+    // together
+    static void append_string(stream_digest_class& key, const std::string& value);
+
+private:
+    std::string directory;
+    uint64_t size_limit;
+
+    void evict() const;
+};
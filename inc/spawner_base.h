@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
@@ -9,6 +10,28 @@
 #include "arguments.h"
 #include "inc/compatibility.h"
 
+// Spread of one quantity over the measured runs of a repeated program.
+struct sample_statistics_t {
+    double min = 0;
+    double max = 0;
+    double median = 0;
+    double mean = 0;
+    double stddev = 0;
+    double p95 = 0;
+    double total = 0;
+    size_t count = 0;
+    // false if the samples are the monitor's, not the values of the runs
+    bool exact = true;
+};
+
+struct run_statistics_t {
+    size_t runs = 0;
+    size_t warmup = 0;
+    sample_statistics_t processor_time; // microseconds
+    sample_statistics_t user_time;      // microseconds
+    sample_statistics_t peak_memory;    // bytes
+};
+
 class spawner_base_c {
     multipipe_ptr spawner_stdin;
     multipipe_ptr spawner_stdout;
@@ -21,6 +44,24 @@ protected:
 
     multipipe_ptr get_or_create_file_pipe(const std::string& path, pipe_mode mode, options_class::redirect_flags flags);
     multipipe_ptr get_std(std_stream_type type, options_class::redirect_flags flags);
+    // stdin is only read once the processes it feeds are created
+    void start_std_read();
+
+    static const std::string null_device;
+    // a pipe that gives the file to the process as is
+    static multipipe_ptr open_direct_pipe(const std::string& path, std_stream_type type);
+    static size_t parse_count(const std::string& value, const std::string& what, size_t min);
+
+    // Copies the file to memory once, so that disk doesn't add to the
+    // spread of repeated runs. The pipes made by the function returned
+    // read the copy from its beginning, one run at a time.
+    static std::function<multipipe_ptr()> buffer_input(const std::string& path);
+    // Runs a fresh process warmup + repeat times, one after another, and
+    // leaves the last one in last. Stops at the first run cut short by a
+    // limit, there is nothing to measure in the runs after it.
+    run_statistics_t repeat_runs(const std::function<runner*()>& create_runner, size_t warmup, size_t repeat,
+        runner*& last);
+    static run_statistics_t summarize_runs(const std::vector<report_class>& reports, size_t warmup);
 
 public:
     spawner_base_c();
@@ -3,6 +3,8 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
+#include <iostream>
 
 #include "rapidjson/rapidjson.h"
 #include "rapidjson/writer.h"
@@ -11,6 +13,8 @@
 #include "arguments.h"
 #include "sp.h"
 #include "spawner_base.h"
+#include "inc/stream_capture.h"
+#include "inc/stream_digest.h"
 #include "mutex.h"
 
 class spawner_new_c: public spawner_base_c {
@@ -32,8 +36,48 @@ protected:
     mutex_c wait_agent_mutex_;
     mutex_c on_terminate_mutex_;
     std::vector<bool> awaited_agents_;
+    std::string batch_manifest_;
+    std::string jobs_ = "1";
+    std::string serve_socket_;
+    std::string repeat_;
+    std::string warmup_;
+    run_statistics_t statistics_;
+    std::string cache_directory_;
+    std::string cache_limit_ = "1024";
+    bool no_cache_ = false;
+    // sinks of *cmp:, *hash: and *capture: redirects, nothing else holds them
+    std::vector<multipipe_ptr> inspected_pipes_;
+    // digests of *hash: redirects by runner index and stream
+    std::map<std::pair<int, std_stream_type>, std::shared_ptr<stream_digest_class>> digests_;
+    // the same for *capture: redirects
+    std::map<std::pair<int, std_stream_type>, std::shared_ptr<stream_capture_class>> captures_;
+    std::ostream* report_stream_ = &std::cout;
+    struct batch_case_t_ {
+        std::string input;
+        std::string output;
+        restrictions_class restrictions;
+    };
     void setup_stream_in_control_mode_(runner* runner, multipipe_ptr pipe);
     void setup_stream_(const options_class::redirect redirect, std_stream_type source_type, runner* this_runner);
+    bool can_hand_off_(const runner* runner, const std::vector<options_class::redirect>& redirects, std_stream_type type,
+        const std::map<std::string, int>& file_users, const std::set<std::pair<int, std_stream_type>>& pipe_targets) const;
+    void init_streams_();
+    std::vector<batch_case_t_> read_batch_manifest_(const restrictions_class& defaults) const;
+    runner* create_batch_runner_(const batch_case_t_& batch_case, const std::string& program,
+        const std::string& resolved_program, const options_class& defaults) const;
+    std::string resolve_program_(const std::string& program) const;
+    void run_batch_();
+    bool repeat_mode_() const;
+    void run_repeat_();
+    size_t jobs_count_() const;
+    std::string cache_key_() const;
+    bool restore_cached_(const std::string& key);
+    void store_cached_(const std::string& key);
+    std::string render_report_(runner* runner_instance);
+    void setup_runners_();
+    std::string check_request_() const;
+    std::string serve_request_(std::vector<std::string>& arguments);
+    void serve_();
     void process_controller_message_(const std::string& message);
     void process_agent_message_(const std::string& message, int runner_index);
     int get_agent_index_(const std::string& message);
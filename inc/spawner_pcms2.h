@@ -5,10 +5,16 @@
 #include "spawner_old.h"
 
 class spawner_pcms2_c: public spawner_old_c {
+protected:
+    std::string repeat;
+    std::string warmup;
+    run_statistics_t statistics;
+
 public:
     spawner_pcms2_c(settings_parser_c &parser);
     virtual void begin_report();
     virtual bool init();
+    virtual void run();
     virtual void print_report();
     virtual std::string help();
     virtual void init_arguments();
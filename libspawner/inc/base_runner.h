@@ -31,6 +31,8 @@ protected:
 public:
     virtual ~base_runner();
     multipipe_ptr get_pipe(const std_stream_type &stream_type, options_class::redirect_flags flags = options_class::pipe_default);
+    // makes the process use the pipe's handle directly
+    void set_pipe(const std_stream_type &stream_type, multipipe_ptr pipe);
     virtual restrictions_class get_restrictions() const {return restrictions_class(); }
     base_runner(const std::string &program, const options_class &options);
     void finalize();
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <functional>
+#include <stdexcept>
 
 void set_on_panic_action(const std::function<void()>& action);
 void set_error_text(const std::string& error_text);
@@ -18,6 +19,25 @@ void panic_(const std::string& error_message, const char* filename, int line_num
     } \
 } while (false)
 
+// What a panic throws in a thread that has a throw_on_panic alive
+class panic_error : public std::runtime_error {
+public:
+    explicit panic_error(const std::string& error_text)
+        : std::runtime_error(error_text) {
+    }
+};
+
+// For a failure that concerns a single request of a long-lived process:
+// panics of the calling thread throw panic_error instead of ending the
+// process, and leave the error text and the on-panic action alone.
+// A child forked by the thread still exits.
+class throw_on_panic final {
+public:
+    throw_on_panic();
+    throw_on_panic(const throw_on_panic&) = delete;
+    ~throw_on_panic();
+};
+
 class finally final {
     typedef std::function<void()> handler_t_;
 public:
@@ -1,6 +1,8 @@
 #ifndef PIPE_H
 #define PIPE_H
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -23,6 +25,8 @@ typedef shared_ptr<multipipe> multipipe_ptr;
 
 class multipipe {
     static int PIPE_ID_COUNTER;
+    // changes whenever any pipe is connected or disconnected
+    static std::atomic<int> TOPOLOGY_COUNTER;
     static const int SLEEP_TIME;
     static const int DEFAULT_BUFFER_SIZE;
 
@@ -31,22 +35,40 @@ class multipipe {
     system_pipe_ptr core_pipe;
     thread* listen_thread;
     mutex write_mutex, stop_mutex;
+    // on Linux pipes are read by a shared reactor instead of listen_thread
+    bool reactor_listening, reactor_finished;
+    std::condition_variable listen_finished;
 
     int buffer_size;
     char *read_buffer, *read_tail_buffer;
     size_t read_tail_len, write_tail_len;
     bool check_new_line, custom_process_message, stop_flag;
+    // data is moved to the sinks inside the kernel, see set_new_line_checking()
+    std::atomic<bool> zero_copy;
 
     pipe_mode mode;
     volatile int parents_count;
+    // TOPOLOGY_COUNTER the newline and splice decisions were made for
+    int topology;
     map<int, weak_ptr<multipipe>> sinks;
 
     std::function<void(const char* buffer, size_t count)> process_message;
+    // see set_inspector(); inspected stays set so that sources can read it
+    // without locking
+    std::function<void(const char* buffer, size_t count)> inspector;
+    bool inspected;
 
     multipipe(system_pipe_ptr pipe, int buffer_size, pipe_mode mode, bool autostart = true);
 
     void set_new_line_checking();
     void listen();
+    bool listen_once();
+#if defined(__linux__)
+    bool needs_listen_thread() const;
+    void on_readable();
+#endif
+    void split_lines(const char* begin, const char* end);
+    bool relay(bool &eof);
     bool stop();
 
     void write(const char* bytes, size_t count, set<int>& src);
@@ -59,6 +81,7 @@ public:
     static multipipe_ptr create_pipe(pipe_mode mode, bool flush = true, int buffer_size = DEFAULT_BUFFER_SIZE);
     static multipipe_ptr open_file(const string& filename, bool excl = false, int buffer_size = DEFAULT_BUFFER_SIZE);
     static multipipe_ptr create_file(const string& filename, bool flush = false, bool excl = false, int buffer_size = DEFAULT_BUFFER_SIZE);
+    static multipipe_ptr adopt_file(pipe_handle handle, int buffer_size = DEFAULT_BUFFER_SIZE);
     ~multipipe();
 
     void start_read();
@@ -73,6 +96,11 @@ public:
 
     void set_custom_process_message(std::function<void(const char* buffer, size_t count)> func);
     bool process_message_is_custom() const;
+    // shows the data written to a write_mode pipe to func before the pipe
+    // gets it, and a null buffer once the pipe is closed; the data is never
+    // spliced past it, and sources feeding it are read by a thread of their
+    // own rather than by the reactor
+    void set_inspector(std::function<void(const char* buffer, size_t count)> func);
 
     system_pipe_ptr get_pipe() const;
 };
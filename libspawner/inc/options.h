@@ -21,6 +21,13 @@ struct options_class
         file,
         pipe,
         std,
+        // the output is checked against the named file, see stream_comparator.h
+        compare,
+        // only the digest of the output is kept, see stream_digest.h
+        hash,
+        // only the beginning and the end of the output are kept, see
+        // stream_capture.h
+        capture,
     };
 
     struct redirect_flags {
@@ -38,6 +45,10 @@ struct options_class
         std::string original = "";
         int pipe_index = -1;
         redirect_flags flags = file_default;
+        // compare redirects: line by line instead of token by token
+        bool compare_lines = false;
+        // capture redirects: bytes kept at either end
+        size_t capture_limit = 0;
     };
 
     session_class session;
@@ -48,6 +59,14 @@ struct options_class
 
     std::string string_arguments;
     std::string working_directory;
+    std::string cgroup_root; // delegated cgroup v2 directory, empty to use rlimits
+    size_t cgroup_cpus = 0; // cpu.max bandwidth in whole cpus, 0 leaves it unlimited
+    std::string spawn_engine = "fork"; // "fork" or "vfork"
+    std::string cpus; // "0-3,8", cpus a child may get one of
+    bool skip_smt_siblings = false;
+    bool perf_counters = false; // count instructions and task clock, Linux only
+    std::string seccomp_profile; // syscalls allowed under the security limit besides the built-in ones, Linux only
+    size_t sandbox_pool = 0; // run in namespaces, this many sandboxes are kept ready, Linux only
 
     std::string login;
     std::string password;
@@ -91,6 +110,8 @@ struct options_class
     void add_stdoutput(const std::string &redirect_str);
     void add_stderror(const std::string &redirect_str);
     void add_environment_variable(const std::string &envStr);
+    void set_sandbox_pool(const std::string &count);
+    void set_cgroup_cpus(const std::string &count);
     void clear_stdinput();
     void clear_stdoutput();
     void clear_stderror();
@@ -0,0 +1,33 @@
+#ifndef _ENVIRONMENT_BLOCK_H_
+#define _ENVIRONMENT_BLOCK_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The envp of a process, built once per environment mode and set of
+// variables and shared by every runner that asks for the same. Strings and
+// pointers live in two allocations, environ is only read.
+class environment_block_class {
+public:
+    typedef std::list<std::pair<std::string, std::string>> variables_t;
+
+    // panics on a mode that isn't supported
+    static std::shared_ptr<const environment_block_class> get(const std::string &mode, const variables_t &variables);
+
+    environment_block_class(const environment_block_class &) = delete;
+    environment_block_class &operator=(const environment_block_class &) = delete;
+
+    // nullptr terminated, valid as long as the block is
+    char **data() const;
+
+private:
+    std::vector<char> arena;
+    std::vector<char *> pointers;
+
+    environment_block_class(const std::string &mode, const variables_t &variables);
+};
+
+#endif // _ENVIRONMENT_BLOCK_H_
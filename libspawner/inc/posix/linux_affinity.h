@@ -1,8 +1,33 @@
 #include <sched.h>
 
+#include <string>
+
+// Hands every child a cpu of its own. Cpus are reserved with flock() on a
+// lock file per cpu in a directory of the user, so runners of other sp
+// processes of the same user keep off them too; a lock goes away with its
+// descriptor, even if sp dies.
 class linux_affinity_class {
 private:
     cpu_set_t cpumask;
+    int cpu = -1;
+    int lock_fd = -1;
+
+    bool try_lock(int candidate);
 public:
+    linux_affinity_class();
+    ~linux_affinity_class();
+
+    linux_affinity_class(const linux_affinity_class &) = delete;
+    linux_affinity_class &operator=(const linux_affinity_class &) = delete;
+
+    // cpus is a list like "0-3,8", empty for all cpus sp may run on;
+    // false if it is malformed or has none of them. Without a free cpu
+    // the child shares the whole set, runners which depend on each other
+    // can't wait for one another forever that way.
+    bool reserve(const std::string &cpus, bool skip_smt_siblings);
+    void release();
+    // only calls sched_setaffinity(), so a vfork()ed child may call it
     bool set(pid_t p);
+    // -1 if no cpu is reserved
+    int get_cpu() const;
 };
@@ -0,0 +1,66 @@
+#ifndef _CGROUP_CLASS_H_
+#define _CGROUP_CLASS_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// A leaf cgroup v2 created for a single runner under a delegated root.
+// Limits are enforced by the kernel, so the monitor doesn't have to
+// sample them; OOM kills are reported through inotify on memory.events.
+class cgroup_class {
+public:
+    typedef std::function<void()> oom_handler_t;
+
+    cgroup_class();
+    ~cgroup_class();
+
+    cgroup_class(const cgroup_class &) = delete;
+    cgroup_class &operator=(const cgroup_class &) = delete;
+
+    // creates <root>/<name>; the root must have the needed controllers
+    // enabled in its cgroup.subtree_control
+    bool create(const std::string &root, const std::string &name);
+    // kills everything left in the cgroup and removes it
+    void destroy();
+    bool is_active() const;
+    const std::string &get_path() const;
+
+    bool attach(pid_t pid);
+    // moves the calling process, only does a write() to a descriptor
+    // opened by create(), so a vfork()ed child may call it
+    bool attach_self();
+
+    bool set_memory_limit(uint64_t bytes);
+    bool set_pids_limit(uint64_t count);
+    // bandwidth of this many cpus
+    bool set_cpu_limit(uint64_t cpus, uint64_t period_us = 100000);
+
+    bool watch_oom(const oom_handler_t &handler);
+
+    bool read_memory_peak(uint64_t &bytes) const;
+    bool read_cpu_usage(uint64_t &usage_us, uint64_t &user_us, uint64_t &system_us) const;
+    uint64_t read_oom_kills() const;
+
+private:
+    struct oom_watch_t {
+        int inotify_fd = -1;
+        uint64_t reported = 0;
+        std::mutex handler_mutex;
+        oom_handler_t handler;
+    };
+
+    std::string path;
+    int procs_fd = -1;
+    std::shared_ptr<oom_watch_t> oom_watch;
+
+    bool write_file(const std::string &file, const std::string &value) const;
+    bool read_file(const std::string &file, std::string &value) const;
+    bool read_key(const std::string &file, const char *key, uint64_t &value) const;
+};
+
+#endif // _CGROUP_CLASS_H_
@@ -0,0 +1,38 @@
+#ifndef _PERF_COUNTERS_CLASS_H_
+#define _PERF_COUNTERS_CLASS_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Task clock and user space instructions of a child and of everything it
+// starts, counted by perf_event. Instructions hardly depend on the load of
+// the host, unlike wall clock and utime. Virtual machines often have no
+// hardware counters, only the task clock is counted then.
+class perf_counters_class {
+public:
+    perf_counters_class();
+    ~perf_counters_class();
+
+    perf_counters_class(const perf_counters_class &) = delete;
+    perf_counters_class &operator=(const perf_counters_class &) = delete;
+
+    // whether instructions can be counted on this host, probed once
+    static bool instructions_supported();
+
+    // counting starts at the next exec() of the child if it hasn't
+    // exec()ed yet, right away otherwise
+    void open(pid_t pid, bool before_exec);
+    void close();
+
+    bool counts_instructions() const;
+    bool counts_task_clock() const;
+    // processes started by the child add to the counts once they exit
+    bool read_instructions(uint64_t &count) const;
+    bool read_task_clock(uint64_t &nanoseconds) const;
+
+private:
+    int instructions_fd = -1;
+    int task_clock_fd = -1;
+};
+
+#endif // _PERF_COUNTERS_CLASS_H_
@@ -0,0 +1,48 @@
+#ifndef _PIDFD_WATCH_CLASS_H_
+#define _PIDFD_WATCH_CLASS_H_
+
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#include "linux_reactor.h"
+
+// Waits for state changes of all children in a single reactor thread.
+// Exits are reported through pidfd readiness, stops and continues through
+// a SIGCHLD self-pipe, since pidfds only become readable on exit.
+class pidfd_watch_class {
+public:
+    // status is in the waitpid() format, usage is that of the child and
+    // of its reaped descendants, as wait4() gives it
+    typedef std::function<void(int status, const struct rusage &usage)> handler_t;
+
+    static pidfd_watch_class &instance();
+
+    // returns false if the kernel has no pidfd support; the caller is
+    // expected to fall back to a blocking waitpid()
+    bool watch(pid_t pid, const handler_t &handler);
+
+private:
+    struct watch_t {
+        pid_t pid;
+        handler_t handler;
+    };
+
+    reactor_class reactor;
+    int sigchld_pipe[2];
+
+    std::mutex watches_mutex;
+    std::map<int, watch_t> watches; // by pidfd
+
+    pidfd_watch_class();
+    ~pidfd_watch_class();
+
+    bool poll(int pidfd, watch_t &watch, bool &gone);
+    void poll(int pidfd);
+    void poll_all();
+};
+
+#endif // _PIDFD_WATCH_CLASS_H_
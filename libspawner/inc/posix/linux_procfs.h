@@ -1,6 +1,8 @@
 #ifndef _PROCFS_CLASS_H_
 #define _PROCFS_CLASS_H_
 #include <string>
+#include <stdint.h>
+#include <time.h>
 
 #define STAT_UTIME_POS 13
 #define STAT_STIME_POS 14
@@ -24,12 +26,28 @@ struct procfs_class {
     size_t stat_vsize, stat_rss;
     size_t vss_max = 0, rss_max = 0;
 
+    // process-wide cpu clock (user + system time of all threads) in ns,
+    // stat_utime is only precise to a scheduler tick
+    bool discovered_cpu_clock = false;
+    clockid_t cpu_clock;
+    uint64_t cpu_time = 0;
+
     std::string io_path, stat_path;
 
+    // opened once by probe_pid() and re-read with pread() on every fill
+    int io_fd = -1, stat_fd = -1;
+
+    procfs_class() = default;
+    procfs_class(const procfs_class &) = delete;
+    procfs_class &operator=(const procfs_class &) = delete;
+    ~procfs_class();
+
     void probe_pid(pid_t);
+    void close_files();
 
     bool fill_stat();
     bool fill_io();
+    bool fill_cpu_time();
     bool fill_all();
 };
 #endif // _PROCFS_CLASS_H_
@@ -0,0 +1,53 @@
+#ifndef _REACTOR_CLASS_H_
+#define _REACTOR_CLASS_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+// One epoll set serviced by a fixed number of worker threads.
+// Workers are started on the first add(). With more than one worker,
+// descriptors should be registered with EPOLLONESHOT and rearm()ed by
+// their handler, otherwise the same event may be handled concurrently.
+class reactor_class {
+public:
+    typedef std::function<void(uint32_t events)> handler_t;
+
+    explicit reactor_class(int workers_count = 1);
+    ~reactor_class();
+
+    // process-wide reactor for short handlers that never block
+    static reactor_class &instance();
+
+    bool add(int fd, uint32_t events, const handler_t &handler);
+    bool rearm(int fd, uint32_t events);
+    void remove(int fd);
+    // wakes and joins the workers, handlers are not called afterwards
+    void stop();
+
+private:
+    struct registration_t {
+        int fd;
+        std::shared_ptr<handler_t> handler;
+    };
+
+    int epoll_fd;
+    int wakeup_fd;
+    int workers_count;
+    volatile bool stopping;
+    uint64_t last_id;
+
+    std::mutex registrations_mutex;
+    std::map<uint64_t, registration_t> registrations;
+    std::map<int, uint64_t> ids;
+    std::vector<std::thread> workers;
+
+    void worker_body();
+};
+
+#endif // _REACTOR_CLASS_H_
@@ -0,0 +1,88 @@
+#ifndef _SANDBOX_CLASS_H_
+#define _SANDBOX_CLASS_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <sys/types.h>
+
+// A set of user, pid, mount, net, ipc and uts namespaces kept alive by an
+// init process of its own. The user namespace maps the uid and gid of the
+// spawner to themselves; the mount namespace sees the host tree with /proc
+// of the pid namespace and a private /dev/shm; the network has only lo.
+//
+// Processes join with enter() in the child, which also makes its children
+// members of the pid namespace. reset() makes the init kill whatever is
+// left in the namespaces and drop their System V IPC objects and /dev/shm,
+// so that the sandbox can be handed to the next process.
+class sandbox_class {
+public:
+    sandbox_class();
+    ~sandbox_class();
+
+    sandbox_class(const sandbox_class &) = delete;
+    sandbox_class &operator=(const sandbox_class &) = delete;
+
+    // false with errno set if the namespaces can't be created
+    bool create();
+    void destroy();
+
+    // in a single-threaded child: no allocations, nothing but syscalls
+    bool enter() const;
+
+    // asks the init to clean up and returns at once
+    bool reset();
+    // waits for the last reset(), false if the sandbox is no longer usable
+    bool wait_ready();
+    // whether wait_ready() would return at once
+    bool is_ready() const;
+
+private:
+    enum namespace_t {
+        namespace_user, // must be joined first
+        namespace_mnt,
+        namespace_net,
+        namespace_ipc,
+        namespace_uts,
+        namespace_pid,
+        namespace_max,
+    };
+
+    pid_t init_pid = -1;
+    int control_fd = -1;
+    int namespace_fds[namespace_max];
+    bool resetting = false;
+
+    static int init_main(void *arg);
+    static bool set_up_init();
+    static void clean_up_init();
+};
+
+// Sandboxes ready to be entered. The first acquire() creates as many as the
+// pool is asked to keep, released ones are reset and reused, the one that
+// has been reset first is handed out first. Nothing that blocks is done
+// under the lock.
+class sandbox_pool_class {
+public:
+    typedef std::shared_ptr<sandbox_class> sandbox_ptr;
+
+    static sandbox_pool_class &instance();
+
+    // panics if a sandbox can't be created
+    sandbox_ptr acquire(size_t pool_size);
+    // once nothing of the sandbox's last process is running
+    void release(sandbox_ptr sandbox, size_t pool_size);
+
+private:
+    std::mutex pool_mutex;
+    // in the order they were released
+    std::deque<sandbox_ptr> ready;
+    bool filled = false;
+
+    sandbox_ptr create_sandbox();
+    // under pool_mutex, null if the pool is empty
+    sandbox_ptr take_ready();
+};
+
+#endif // _SANDBOX_CLASS_H_
@@ -42,13 +42,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 
-#include <errno.h>
+#include <stdint.h>
 #include <stddef.h>
 #include <sys/prctl.h>
 #ifndef PR_SET_NO_NEW_PRIVS
 # define PR_SET_NO_NEW_PRIVS 38
 #endif
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include <linux/audit.h>
 #include <linux/unistd.h>
 #include <linux/filter.h>
@@ -56,71 +60,80 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define syscall_nr (offsetof(struct seccomp_data, nr))
 #define arch_nr (offsetof(struct seccomp_data, arch))
-
+#define syscall_args (offsetof(struct seccomp_data, args))
 
 #if defined(__i386__)
-# define REG_SYSCALL    REG_EAX
 # define ARCH_NR        AUDIT_ARCH_I386
 #elif defined(__x86_64__)
-# define REG_SYSCALL    REG_RAX
 # define ARCH_NR        AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+# define ARCH_NR        AUDIT_ARCH_AARCH64
 #endif
 
-#define VALIDATE_ARCHITECTURE \
-        BPF_STMT(BPF_LD+BPF_W+BPF_ABS, arch_nr), \
-        BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, ARCH_NR, 1, 0), \
-        BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_KILL)
-
-#define EXAMINE_SYSCALL \
-        BPF_STMT(BPF_LD+BPF_W+BPF_ABS, syscall_nr)
-
-#define ALLOW_SYSCALL(name) \
-        BPF_JUMP(BPF_JMP+BPF_JEQ+BPF_K, __NR_##name, 0, 1), \
-        BPF_STMT(BPF_RET+BPF_K, SECCOMP_RET_ALLOW)
-
-#define KILL_PROCESS \
-        BPF_STMT(BPF_RET+BPF_K, RESTRICTION_TYPE)
-
 #define RESTRICTION_TYPE SECCOMP_RET_KILL // silently kill child
 //#define RESTRICTION_TYPE SECCOMP_RET_TRAP // send SIGSYS
 
+#ifndef SECCOMP_MODE_FILTER
 #define SECCOMP_MODE_FILTER    2 /* uses user-supplied filter. */
+#endif
+#ifndef SECCOMP_RET_KILL
 #define SECCOMP_RET_KILL       0x00000000U /* kill the task immediately */
+#endif
+#ifndef SECCOMP_RET_TRAP
 #define SECCOMP_RET_TRAP       0x00030000U /* disallow and force a SIGSYS */
+#endif
+#ifndef SECCOMP_RET_ALLOW
 #define SECCOMP_RET_ALLOW      0x7fff0000U /* allow */
-
-// syscalls filters to allow execve()
-static struct sock_filter filter[] = {
-    VALIDATE_ARCHITECTURE,
-    EXAMINE_SYSCALL,
-    ALLOW_SYSCALL(rt_sigreturn),
-    ALLOW_SYSCALL(exit_group),
-    ALLOW_SYSCALL(exit),
-    ALLOW_SYSCALL(read),
-    ALLOW_SYSCALL(write),
-    ALLOW_SYSCALL(rt_sigprocmask),
-    ALLOW_SYSCALL(rt_sigaction),
-    ALLOW_SYSCALL(nanosleep),
-    ALLOW_SYSCALL(brk),
-    ALLOW_SYSCALL(execve),
-    ALLOW_SYSCALL(close),
-    ALLOW_SYSCALL(open),
-    ALLOW_SYSCALL(access),
-    ALLOW_SYSCALL(fstat),
-    ALLOW_SYSCALL(mmap),
-#if defined(__x86_64__)
-    ALLOW_SYSCALL(arch_prctl),
 #endif
-    ALLOW_SYSCALL(munmap),
-    ALLOW_SYSCALL(mprotect),
-    KILL_PROCESS,
-};
-static struct sock_fprog prog = {
-    .len = (unsigned short)(sizeof(filter)/sizeof(filter[0])),
-    .filter = filter,    
+
+// A syscall allowlist compiled into a BPF program. The syscall number is
+// looked up in a balanced binary tree, so a syscall costs O(log n)
+// comparisons however long the list is.
+//
+// A profile has a syscall per line, by name or number, optionally followed
+// by checks of its arguments that must all hold:
+//
+//     # comment
+//     openat
+//     socket arg0 == 1         # AF_UNIX only
+//     mmap arg2 & 4 == 0       # no PROT_EXEC
+//
+// Lines of the same syscall are alternatives. The profile extends the
+// built-in list, which lets a statically or dynamically linked program
+// start, read and write its standard streams and exit.
+class seccomp_filter_class {
+public:
+    seccomp_filter_class();
+
+    // panics on a file that can't be read or parsed
+    void load_profile(const std::string &file);
+    // the compiled program is what the child installs
+    void compile();
+
+    // both are called in the child before execve() and don't allocate
+    static bool is_supported();
+    bool install() const;
+
+private:
+    struct check_t {
+        unsigned arg;
+        uint64_t mask;
+        uint64_t value;
+        bool equal;
+    };
+    typedef std::vector<check_t> rule_t;
+
+    // an empty rule allows the syscall unconditionally
+    std::map<uint32_t, std::vector<rule_t>> rules;
+    std::vector<struct sock_filter> program;
+
+    void allow(uint32_t nr, const rule_t &rule);
+    void parse_line(const std::string &line, const std::string &where);
+
+    std::vector<struct sock_filter> compile_range(
+        std::map<uint32_t, std::vector<rule_t>>::const_iterator begin, size_t count) const;
+    std::vector<struct sock_filter> compile_syscall(uint32_t nr, const std::vector<rule_t> &alternatives) const;
+    std::vector<struct sock_filter> compile_rule(const rule_t &rule) const;
 };
- 
-int seccomp_probe_filter();
-int seccomp_setup_filter();
 
 #endif
@@ -0,0 +1,44 @@
+#ifndef _DEADLINE_TIMER_CLASS_H_
+#define _DEADLINE_TIMER_CLASS_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <stdint.h>
+
+// A CLOCK_MONOTONIC timerfd watched by the shared reactor, so a deadline
+// is met when it comes rather than at the next monitor tick. The handler
+// runs on a reactor thread and may arm the timer again.
+class deadline_timer_class {
+public:
+    typedef std::function<void()> handler_t;
+
+    deadline_timer_class();
+    ~deadline_timer_class();
+
+    deadline_timer_class(const deadline_timer_class &) = delete;
+    deadline_timer_class &operator=(const deadline_timer_class &) = delete;
+
+    bool start(const handler_t &handler);
+    // once a handler being run has returned, it is not called again
+    void stop();
+    bool is_active() const;
+
+    // at a point of CLOCK_MONOTONIC, in nanoseconds
+    bool arm_at(uint64_t monotonic_ns);
+    bool arm_after(uint64_t delay_ns);
+
+private:
+    struct watch_t {
+        int timer_fd = -1;
+        std::mutex handler_mutex;
+        handler_t handler;
+    };
+
+    std::shared_ptr<watch_t> watch;
+
+    bool arm(uint64_t ns, int flags);
+};
+
+#endif // _DEADLINE_TIMER_CLASS_H_
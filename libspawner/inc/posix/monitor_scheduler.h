@@ -0,0 +1,70 @@
+#ifndef _MONITOR_SCHEDULER_CLASS_H_
+#define _MONITOR_SCHEDULER_CLASS_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+// Samples all monitored runners from a single thread.
+// Tasks are kept in a hashed timer wheel whose tick equals the smallest
+// interval among the current tasks, so the thread wakes up once per tick
+// and runs every due task in a batch, no matter how many runners there are.
+class monitor_scheduler_class {
+public:
+    // returns false when monitoring is over and the task should be dropped
+    typedef std::function<bool()> task_t;
+    typedef std::function<void()> done_t;
+
+    static monitor_scheduler_class &instance();
+
+    // interval is in microseconds; done is called from a completion thread
+    // after the task has returned false, so it may block without holding
+    // up the other tasks
+    void add(uint64_t interval, const task_t &task, const done_t &done);
+
+private:
+    struct entry_t {
+        uint64_t interval;
+        uint64_t deadline;
+        task_t task;
+        done_t done;
+    };
+    typedef std::list<entry_t> slot_t;
+
+    static const size_t slots_count = 256;
+
+    std::mutex wheel_mutex;
+    std::condition_variable wheel_cond;
+    std::vector<slot_t> slots;
+    std::multiset<uint64_t> intervals; // of every task, the wheel is rebuilt for the smallest
+    size_t entries_count;
+    uint64_t resolution; // microseconds per tick, 0 while nothing was added
+    uint64_t current_tick;
+    bool stopping;
+
+    std::thread scheduler_thread;
+
+    std::mutex completion_mutex;
+    std::condition_variable completion_cond;
+    std::deque<done_t> completions;
+    bool completions_closed;
+    std::thread completion_thread;
+
+    monitor_scheduler_class();
+    ~monitor_scheduler_class();
+
+    static uint64_t now();
+    void place(entry_t &&entry);
+    void rebuild(uint64_t new_resolution);
+    void scheduler_body();
+    void completion_body();
+};
+
+#endif // _MONITOR_SCHEDULER_CLASS_H_
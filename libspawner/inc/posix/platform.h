@@ -32,6 +32,9 @@ void platform_exit_failure();
 
 #ifdef __MACH__
 #define CLOCK_REALTIME 0
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC CLOCK_REALTIME
+#endif
 unsigned long long int clock_gettime(int, struct timespec *);
 #endif
 
@@ -4,8 +4,10 @@
 #include <condition_variable>
 #include <mutex>
 #include <semaphore.h>
+#include <signal.h>
 #include <sys/resource.h>
 #include <thread>
+#include <vector>
 
 #include "inc/base_runner.h"
 
@@ -13,6 +15,8 @@
 #include "linux_affinity.h"
 #include "linux_seccomp.h"
 #include "linux_procfd.h"
+#include "linux_pidfd.h"
+#include "linux_sandbox.h"
 #endif
 
 class runner: public base_runner {
@@ -21,6 +25,8 @@ private:
 
     std::thread waitpid_thread;
     pid_t proc_pid;
+    // set by set_resolved_program(), resolved on every start otherwise
+    std::string resolved_program;
 
     struct rusage ru;  // precise resource usage storage
     bool ru_success = false;
@@ -34,18 +40,37 @@ private:
     int child_reportbuf;
 #if defined(__linux__)
     linux_affinity_class affinity;
+    // namespaces the child runs in, if options.sandbox_pool is set
+    sandbox_pool_class::sandbox_ptr sandbox;
 #endif
-    env_vars_list_t read_environment() const;
-    char **create_envp_for_process() const;
     char **create_argv_for_process() const;
     void release_argv_for_process(char **argv) const;
 
-    // environ pointer protector, may be replaced with global lock
-    mutable std::mutex envp_mtx;
+#if defined(__linux__)
+    // everything the vfork engine's child needs, prepared by the parent
+    struct spawn_args_t {
+        runner *self;
+        const char *cmd;
+        char **argv;
+        char **envp;
+        const char *wd;
+        int stdio[3];
+        int error_fd;
+        sigset_t mask;
+    };
+    static int spawn_child(void *arg);
+    void spawn_process(const char *cmd_toexec, const char *wd);
+#endif
 
     std::mutex waitpid_cond_mtx;
     std::condition_variable waitpid_cond;
     bool waitpid_ready = false;
+    // child is watched by the shared pidfd event loop instead of waitpid_thread
+    bool waitpid_watched = false;
+    bool waitpid_done = false;
+
+    bool update_status(int status);
+    void finish_wait(const struct rusage &usage);
 
     signal_t runner_signal;
     int exit_code;
@@ -54,15 +79,27 @@ protected:
     int change_credentials();
 
     unsigned long long int creation_time;
+    // the process was created by the vfork engine and has already exec'd
+    bool vforked = false;
     virtual void runner_free();
 
     virtual void init_process(const char *cmd, char **process_argv, char **process_envp);
+    // Called in the child of the vfork engine, which shares memory with the
+    // parent: only async-signal-safe calls, no allocations. The first one
+    // runs before inherited descriptors are closed, the second right
+    // before execve().
+    virtual bool init_spawned_child();
+    virtual bool restrict_spawned_child();
+    // whether the parent has to get hold of the child before it exec()s,
+    // which a child of the vfork engine has done already
+    virtual bool attaches_before_exec() const;
     virtual void create_process();
     virtual void requisites();
 
     virtual void wait();
 
-    virtual timeval get_user_time();
+    // the user time of the child if it is known better than by wait4()
+    virtual bool get_user_time(timeval &time);
 public:
     pid_t get_proc_pid();
     void run_waitpid();
@@ -75,6 +112,10 @@ public:
     virtual void run_process_async();
     options_class get_options() const;
     std::string get_program() const;
+    // The real path of a regular file, panics otherwise. Runners of the
+    // same program may share it, resolving it again would be wasted.
+    static std::string resolve_program(const std::string &program);
+    void set_resolved_program(const std::string &path);
     bool wait_for();
     bool wait_for_init(const unsigned long& interval);
     void suspend();
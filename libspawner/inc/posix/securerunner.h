@@ -6,10 +6,14 @@
 #include <queue>
 
 #include "runner.h"
+#include "monitor_scheduler.h"
 
 #if defined(__linux__)
 #include "linux_procfs.h"
+#include "linux_cgroup.h"
 #include "linux_seccomp.h"
+#include "linux_perf.h"
+#include "linux_timer.h"
 #endif
 
 class secure_runner: public runner
@@ -17,17 +21,43 @@ class secure_runner: public runner
 private:
 #if defined(__linux__)
     procfs_class proc; // rough resource usage storage
+    cgroup_class cgroup; // precise limits, if options.cgroup_root is set
+    perf_counters_class perf; // if options.perf_counters or an instruction limit is set
+    seccomp_filter_class seccomp; // compiled by the parent if the security limit is set
+    // the wall clock limit, then the grace between SIGXCPU and SIGKILL
+    deadline_timer_class deadline;
+    std::atomic<bool> sigxcpu_sent{false};
+    void create_cgroup();
+    bool uses_perf_counters() const;
+    void start_deadline();
+    void on_deadline();
+    // SIGXCPU now, SIGKILL once the grace is over, without blocking the monitor
+    void escalate(terminate_reason_t reason);
 #endif
-    double proc_consumed;
+    // sampled by the monitor to judge the limits, the report has exact times
+    double proc_consumed = 0;
 
-    std::thread proc_thread, monitor_thread;
-    void run_monitor();
+    // state of the monitor between scheduler ticks
+    pid_t proc_pid = 0;
+    // microseconds since creation when SIGKILL follows SIGXCPU, 0 if not sent
+    uint64_t kill_due = 0;
+    // SIGXCPU now, SIGKILL on a later tick once the grace is over
+    void defer_kill(terminate_reason_t reason, uint64_t grace);
+#if defined(__linux__)
+    int tick_res = 0;
+    long ticks_elapsed = 0;
+    bool tick_detected = false;
+    long tick_to_micros = 0;
+    unsigned long long current_time = 0;
+#endif
 
     void prepare_stdio();
 
     std::mutex monitor_cond_mtx;
     std::condition_variable monitor_cond;
-    bool monitor_ready = false;
+    // a process that failed to start has no monitor to wait for
+    bool monitor_added = false;
+    bool monitor_done = false;
 
 protected:
     restrictions_class start_restrictions;
@@ -36,19 +66,27 @@ protected:
     int last_tick, max_load_ratio_index;
     std::deque<double> load_ratios;
     terminate_reason_t terminate_reason;
+    // set by terminate(), taken instead of terminate_reason_by_controller
+    terminate_reason_t requested_terminate_reason = terminate_reason_not_terminated;
     std::atomic<bool> prolong_time_limits_{false};
     virtual bool create_restrictions();
     virtual void init_process(const char *cmd_toexec, char **process_argv, char **process_envp);
+    virtual bool init_spawned_child();
+    virtual bool restrict_spawned_child();
+    virtual bool attaches_before_exec() const override;
     virtual void create_process();
 
-    void check_limits_proc();
+    void init_limits_proc();
+    // a single monitor tick, returns false when monitoring is over
+    bool check_limits_proc();
+    void finish_limits_proc();
 
     virtual void runner_free();
     virtual void requisites();
 
     virtual void wait() override;
 
-    virtual timeval get_user_time() override;
+    virtual bool get_user_time(timeval &time) override;
 public:
     secure_runner(const std::string &program, const options_class &options, const restrictions_class &restrictions);
     virtual ~secure_runner();
@@ -62,6 +100,9 @@ public:
     virtual report_class get_report();
     void prolong_time_limits();
     bool force_stop = false;
+    // stops the process like force_stop does, but reports the given reason;
+    // a process that has already exited is reported with it as well
+    void terminate(terminate_reason_t reason);
     std::function<void()> on_terminate;
 };
 #endif // _SECURE_RUNNER_H_
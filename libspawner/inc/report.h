@@ -20,7 +20,18 @@ public:
         load_ratio(0.0),
         processor_time(0),
         user_time(0),
-        kernel_time(0) {}
+        kernel_time(0),
+        minor_faults(0),
+        major_faults(0),
+        voluntary_context_switches(0),
+        involuntary_context_switches(0),
+        block_input_ops(0),
+        block_output_ops(0),
+        has_instructions(false),
+        has_task_clock(false),
+        sampled_peak_memory(false),
+        instructions(0),
+        task_clock(0) {}
     process_status_t process_status;
 
     terminate_reason_t terminate_reason;
@@ -35,6 +46,21 @@ public:
     unsigned long long user_time;
     // additional info subset
     unsigned long long kernel_time;
+    // from the rusage of the process reaped, zero where there is none
+    unsigned long long minor_faults;
+    unsigned long long major_faults;
+    unsigned long long voluntary_context_switches;
+    unsigned long long involuntary_context_switches;
+    unsigned long long block_input_ops;
+    unsigned long long block_output_ops;
+    // perf counters, if they were asked for and could be opened
+    bool has_instructions;
+    bool has_task_clock;
+    // peak_memory_used is only the largest size the monitor has seen,
+    // zero if it never looked
+    bool sampled_peak_memory;
+    unsigned long long instructions;
+    unsigned long long task_clock; // microseconds
     // options subset
     std::string application_name;
     std::wstring login;
@@ -88,6 +114,7 @@ const terminate_reason_description terminate_reason_descriptions[] = {
     {terminate_reason_debug_event,              "DebugEvent"},//"TERMINATE_REASON_DEBUG_EVENT"},
     {terminate_reason_created_process,          "ProcessesCountLimitExceeded"},
     {terminate_reason_by_controller,            "TerminatedByController"},
+    {terminate_reason_output_mismatch,          "OutputMismatch"},
     {terminate_reason_not_terminated,           nullptr}
 };
 
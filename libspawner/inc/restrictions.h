@@ -17,7 +17,8 @@ enum restriction_kind_t
     restriction_load_ratio              = 0x5,
     restriction_idle_time_limit         = 0x6,
     restriction_processes_count_limit   = 0x7,
-    restriction_max                     = 0x8
+    restriction_instructions_limit      = 0x8,
+    restriction_max                     = 0x9
 };
 
 typedef uint64_t restriction_t;
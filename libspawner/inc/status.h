@@ -25,6 +25,7 @@ enum terminate_reason_t
     terminate_reason_debug_event,
     terminate_reason_created_process,
     terminate_reason_by_controller,
+    terminate_reason_output_mismatch,
 };
 
 #endif//_SPAWNER_STATUS_H_
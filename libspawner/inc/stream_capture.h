@@ -0,0 +1,39 @@
+#ifndef _STREAM_CAPTURE_H_
+#define _STREAM_CAPTURE_H_
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keeps the first and the last bytes of a stream in memory, up to a limit
+// each, and only counts whatever is between them.
+class stream_capture_class {
+public:
+    static const size_t DEFAULT_LIMIT = 4096;
+
+    explicit stream_capture_class(size_t limit = DEFAULT_LIMIT);
+
+    void append(const char *bytes, size_t count);
+    // the stream has ended, the captured data may be read from now on
+    void finish();
+
+    bool is_finished() const;
+    uint64_t size() const;
+    const std::string &head() const;
+    // what came after the head, at most limit bytes of it
+    std::string tail() const;
+
+private:
+    size_t limit;
+    std::string head_data;
+    std::vector<char> ring;
+    // next byte of the ring to be written, and how much of it is filled
+    size_t ring_position = 0;
+    size_t ring_filled = 0;
+    uint64_t bytes_seen = 0;
+    bool finished = false;
+};
+
+#endif // _STREAM_CAPTURE_H_
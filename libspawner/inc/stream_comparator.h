@@ -0,0 +1,65 @@
+#ifndef _STREAM_COMPARATOR_H_
+#define _STREAM_COMPARATOR_H_
+
+#include <functional>
+#include <string>
+
+#include <stddef.h>
+
+// Compares the output of a process with an expected answer while it is
+// being written, so that a wrong answer is known before the process exits.
+// The expected file is mapped into memory; the output may come in pieces
+// of any size and is never stored.
+class stream_comparator_class {
+public:
+    enum compare_mode_t {
+        // whitespace separated tokens, the amount of whitespace doesn't matter
+        compare_tokens,
+        // lines, blanks at the end of lines and empty lines at the end of
+        // the output don't matter
+        compare_lines,
+    };
+    typedef std::function<void()> mismatch_handler_t;
+
+    // panics if the file can't be mapped
+    stream_comparator_class(const std::string &expected_file, compare_mode_t mode);
+    ~stream_comparator_class();
+
+    stream_comparator_class(const stream_comparator_class &) = delete;
+    stream_comparator_class &operator=(const stream_comparator_class &) = delete;
+
+    // called once, on the first difference or when the output ends early
+    void on_mismatch(const mismatch_handler_t &handler);
+
+    void feed(const char *bytes, size_t count);
+    // the output has ended
+    void finish();
+
+    bool mismatched() const;
+
+private:
+    compare_mode_t mode;
+    const char *expected = nullptr;
+    size_t expected_size = 0;
+    // first expected byte that wasn't matched yet
+    size_t position = 0;
+    // tokens: a token is being matched; lines: a line is being matched
+    bool in_token = false;
+    // lines: a blank of the output didn't match, only the end of the line
+    // may follow
+    bool blank_diverged = false;
+    bool failed = false;
+    bool finished = false;
+    mismatch_handler_t handler;
+#if defined(_WIN32)
+    void *mapping = nullptr;
+#endif
+
+    bool at_end() const;
+    void skip_blanks();
+    void fail();
+    void feed_token_byte(char c);
+    void feed_line_byte(char c);
+};
+
+#endif // _STREAM_COMPARATOR_H_
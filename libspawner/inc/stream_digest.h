@@ -0,0 +1,32 @@
+#ifndef _STREAM_DIGEST_H_
+#define _STREAM_DIGEST_H_
+
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <inc/md5/md5.h>
+
+// MD5 and length of a stream, taken as the data goes by instead of from a
+// file written first.
+class stream_digest_class {
+public:
+    stream_digest_class();
+
+    void append(const char *bytes, size_t count);
+    // the stream has ended, hex() is known from now on
+    void finish();
+
+    bool is_finished() const;
+    std::string hex() const;
+    uint64_t size() const;
+
+private:
+    md5_state_t md5_state;
+    md5_byte_t digest[16];
+    uint64_t bytes_seen = 0;
+    bool finished = false;
+};
+
+#endif // _STREAM_DIGEST_H_
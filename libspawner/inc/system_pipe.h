@@ -4,6 +4,7 @@
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include "platform.h"
 #include "std_semaphore.h"
@@ -48,6 +49,12 @@ class system_pipe {
 
     bool autoflush, stop_flush;
 
+    // read and write ends of the pipes used by splice() to tee into
+    // every sink but the last one
+    std::vector<pipe_handle> tee_handles;
+
+    void transfer(pipe_handle from, system_pipe *sink, size_t count);
+
     explicit system_pipe(bool flush, pipe_type t = pipe_type::def);
     void start_flush_thread();
 
@@ -55,6 +62,8 @@ public:
     static system_pipe_ptr open_std(std_stream_type type, bool flush = true);
     static system_pipe_ptr open_pipe(pipe_mode mode, bool flush = true);
     static system_pipe_ptr open_file(const string& filename, pipe_mode mode, bool flush = false, bool excl = false);
+    // takes over a handle of a file opened for reading
+    static system_pipe_ptr adopt_file(pipe_handle handle);
 
     pipe_handle get_input_handle() const;
     pipe_handle get_output_handle() const;
@@ -65,6 +74,10 @@ public:
     bool is_writable() const;
     size_t read(char* bytes, size_t count);
     size_t write(const char* bytes, size_t count);
+    // Moves up to count bytes to all sinks without copying them to user
+    // space. Returns 0 at the end of the stream. If the descriptors can't be
+    // spliced, nothing is moved and unsupported is set.
+    size_t splice(const std::vector<system_pipe_ptr> &sinks, size_t count, bool &unsupported);
     void flush();
     void close(pipe_mode mode);
     void close();
@@ -18,6 +18,8 @@ protected:
     thread_t check_thread;
     thread_t wait_thread;
     std::atomic<bool> prolong_time_limits_{false};
+    // set by terminate(), taken instead of terminate_reason_by_controller
+    terminate_reason_t requested_terminate_reason = terminate_reason_not_terminated;
     LONGLONG base_time_processor_ = 0;
     unsigned long long base_time_user_ = 0;
 
@@ -41,5 +43,8 @@ public:
     virtual report_class get_report();
     void prolong_time_limits();
     bool force_stop = false;
+    // stops the process like force_stop does, but reports the given reason;
+    // a process that has already exited is reported with it as well
+    void terminate(terminate_reason_t reason);
     std::function<void()> on_terminate;
 };
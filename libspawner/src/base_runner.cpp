@@ -26,6 +26,10 @@ multipipe_ptr base_runner::get_pipe(const std_stream_type& stream_type, options_
     return stream->second;
 }
 
+void base_runner::set_pipe(const std_stream_type& stream_type, multipipe_ptr pipe) {
+    streams[stream_type] = pipe;
+}
+
 base_runner::base_runner(const std::string& program, const options_class& options)
     : index(0)
     , options(options)
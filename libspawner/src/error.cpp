@@ -10,12 +10,26 @@ void begin_panic_();
 bool do_we_panic_();
 void exec_on_panic_action_();
 
+// the pid of the process whose thread throws, 0 if none
+static thread_local int throwing_pid_ = 0;
+
+throw_on_panic::throw_on_panic() {
+    throwing_pid_ = get_spawner_pid();
+}
+
+throw_on_panic::~throw_on_panic() {
+    throwing_pid_ = 0;
+}
+
 void panic_(const std::string& error_message, const char* filename, int line_number) {
     logger::print();
     std::stringstream error_text;
     const char *fn = filename + strlen(filename);
     while (fn > filename && fn[-1] != '\\' && fn[-1] != '/') --fn;
     error_text << fn << ":" << line_number << ": " << error_message;
+    if (throwing_pid_ != 0 && throwing_pid_ == get_spawner_pid()) {
+        throw panic_error(error_text.str());
+    }
     set_error_text(error_text.str());
     if (!do_we_panic_()) {
         begin_panic_();
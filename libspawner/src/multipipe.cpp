@@ -1,14 +1,24 @@
 #include "multipipe.h"
 
+#include <algorithm>
 #include <chrono>
 
+#include <string.h>
+
 #include "error.h"
 #include "logger.h"
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+
+#include "linux_reactor.h"
+#endif
+
 using std::chrono::milliseconds;
 using std::this_thread::sleep_for;
 
 int multipipe::PIPE_ID_COUNTER = 0;
+std::atomic<int> multipipe::TOPOLOGY_COUNTER(0);
 const int multipipe::SLEEP_TIME = 100;
 const int multipipe::DEFAULT_BUFFER_SIZE = 65536;
 
@@ -16,15 +26,21 @@ multipipe::multipipe(system_pipe_ptr pipe, int bsize, pipe_mode mode, bool autos
     : id(++PIPE_ID_COUNTER)
     , core_pipe(pipe)
     , listen_thread(nullptr)
+    , reactor_listening(false)
+    , reactor_finished(false)
     , buffer_size(bsize)
     , read_tail_len(0)
     , write_tail_len(0)
     , check_new_line(true)
     , custom_process_message(false)
     , stop_flag(false)
+    , zero_copy(false)
     , mode(mode)
     , parents_count(0)
-    , process_message(nullptr) {
+    , topology(-1)
+    , process_message(nullptr)
+    , inspector(nullptr)
+    , inspected(false) {
     read_buffer = new char[buffer_size];
     read_tail_buffer = new char[buffer_size];
 
@@ -33,14 +49,50 @@ multipipe::multipipe(system_pipe_ptr pipe, int bsize, pipe_mode mode, bool autos
 }
 
 void multipipe::set_new_line_checking() {
-    check_new_line = false;
+    check_new_line = custom_process_message;
+    // Lines only have to be kept whole when several sources share a sink,
+    // everything else may be spliced as is. Sinks with sinks of their own
+    // still need write() to forward the data further.
+    bool can_splice = !sinks.empty();
     for (const auto& sink : sinks) {
         if (auto p = sink.second.lock()) {
             if (!p->get_pipe()->is_file() || p->parents_count > 1) {
                 check_new_line = true;
             }
+            if (p->mode != write_mode || p->parents_count > 1 || !p->sinks.empty() || p->inspected) {
+                can_splice = false;
+            }
+        } else {
+            can_splice = false;
         }
     }
+    zero_copy = can_splice;
+}
+
+bool multipipe::relay(bool &eof) {
+    eof = false;
+    if (!zero_copy || custom_process_message)
+        return false;
+
+    std::vector<system_pipe_ptr> sink_pipes;
+    for (const auto& sink : sinks) {
+        auto p = sink.second.lock();
+        if (!p)
+            return false;
+        sink_pipes.push_back(p->get_pipe());
+    }
+
+    // whatever was read before the switch goes first
+    flush();
+
+    bool unsupported;
+    auto bytes_moved = core_pipe->splice(sink_pipes, buffer_size, unsupported);
+    if (unsupported) {
+        zero_copy = false;
+        return false;
+    }
+    eof = bytes_moved == 0;
+    return true;
 }
 
 void multipipe::listen() {
@@ -48,44 +100,150 @@ void multipipe::listen() {
     if (mode != read_mode && core_pipe->is_readable())
         return;
 
-    if (process_message == nullptr) {
-        process_message = [=](const char* buf, size_t count) { write(buf, count); };
+    while (!stop_flag && listen_once());
+
+    close_and_notify();
+}
+
+bool multipipe::listen_once() {
+    // a sink may have got another parent since this pipe connected to it
+    if (topology != TOPOLOGY_COUNTER) {
+        topology = TOPOLOGY_COUNTER;
+        set_new_line_checking();
     }
 
-    while (!stop_flag) {
-        auto bytes_read = core_pipe->read(read_buffer, buffer_size);
-        if (bytes_read == 0) {
-            break;
-        }
+    bool eof;
+    if (relay(eof))
+        return !eof;
+
+    auto bytes_read = core_pipe->read(read_buffer, buffer_size);
+    if (bytes_read == 0)
+        return false;
+
+    if (check_new_line) {
+        split_lines(read_buffer, read_buffer + bytes_read);
+    } else {
+        flush();
+        process_message(read_buffer, bytes_read);
+    }
+    return true;
+}
+
+#if defined(__linux__)
+static reactor_class &pipes_reactor() {
+    static reactor_class reactor(std::max(1u, std::min(4u, thread::hardware_concurrency())));
+    return reactor;
+}
+
+bool multipipe::needs_listen_thread() const {
+    // A worker must not wait for a process to read its stdin: that process
+    // may itself be waiting for a worker to drain its stdout. Such pipes,
+    // and the controller's messages, which end up in such pipes, are left
+    // to a thread of their own.
+    if (custom_process_message)
+        return true;
+    for (const auto& sink : sinks) {
+        auto p = sink.second.lock();
+        // inspectors don't get to hold up the workers either
+        if (!p || !p->sinks.empty() || p->inspected)
+            return true;
+        auto sink_pipe = p->get_pipe();
+        if (!sink_pipe->is_file() && !sink_pipe->is_console())
+            return true;
+    }
+    return false;
+}
+
+void multipipe::on_readable() {
+    if (topology != TOPOLOGY_COUNTER && needs_listen_thread()) {
+        pipes_reactor().remove(core_pipe->get_input_handle());
+        std::lock_guard<mutex> lock(stop_mutex);
+        listen_thread = new thread(&multipipe::listen, this);
+        reactor_listening = false;
+        listen_finished.notify_all();
+        return;
+    }
+
+    if (!stop_flag && listen_once()) {
+        pipes_reactor().rearm(core_pipe->get_input_handle(), EPOLLIN | EPOLLONESHOT);
+        return;
+    }
+
+    pipes_reactor().remove(core_pipe->get_input_handle());
+    close_and_notify();
+    std::lock_guard<mutex> lock(stop_mutex);
+    reactor_listening = false;
+    reactor_finished = true;
+    listen_finished.notify_all();
+}
+#endif
+
+static const char* find_last_new_line(const char* begin, const char* end) {
+#if defined(__GLIBC__)
+    return (const char*)memrchr(begin, '\n', end - begin);
+#else
+    const char* last = nullptr;
+    for (const char* p = begin; (p = (const char*)memchr(p, '\n', end - p)) != nullptr; p++)
+        last = p;
+    return last;
+#endif
+}
 
-        auto t = read_buffer;
-        for (auto i = 0; i < bytes_read; i++, t++) {
-            // TODO maybe increase buffer dynamic?
-            read_tail_buffer[read_tail_len++] = *t;
-            if (check_new_line && *t == '\n' || read_tail_len >= buffer_size) {
+void multipipe::split_lines(const char* begin, const char* end) {
+    while (begin < end) {
+        if (read_tail_len > 0) {
+            // complete the line left over from the previous read
+            auto new_line = (const char*)memchr(begin, '\n', end - begin);
+            size_t count = (new_line != nullptr ? new_line + 1 : end) - begin;
+            count = std::min(count, buffer_size - read_tail_len);
+            memcpy(read_tail_buffer + read_tail_len, begin, count);
+            read_tail_len += count;
+            begin += count;
+            if (read_tail_buffer[read_tail_len - 1] == '\n' || read_tail_len >= (size_t)buffer_size) {
                 // Clear read buffer in case process_message calls flush.
                 auto len = read_tail_len;
                 read_tail_len = 0;
                 process_message(read_tail_buffer, len);
             }
+            continue;
         }
-    }
 
-    close_and_notify();
+        // Whole lines are passed on without copying: one by one to a custom
+        // handler, which parses messages, and as a single block otherwise.
+        auto last = custom_process_message
+            ? (const char*)memchr(begin, '\n', end - begin)
+            : find_last_new_line(begin, end);
+        if (last == nullptr) {
+            read_tail_len = end - begin;
+            memcpy(read_tail_buffer, begin, read_tail_len);
+            if (read_tail_len >= (size_t)buffer_size) {
+                read_tail_len = 0;
+                process_message(read_tail_buffer, buffer_size);
+            }
+            return;
+        }
+        process_message(begin, last + 1 - begin);
+        begin = last + 1;
+    }
 }
 
 bool multipipe::stop() {
-    stop_mutex.lock();
+    std::unique_lock<mutex> lock(stop_mutex);
+    // the reactor either reaches the end of the stream or hands the pipe
+    // over to a listen thread
+    listen_finished.wait(lock, [this] { return !reactor_listening; });
+    if (reactor_finished) {
+        reactor_finished = false;
+        return true;
+    }
     if (listen_thread != nullptr) {
         // If necessary, the stop_flag will be set.
         system_pipe::cancel_sync_io(listen_thread->native_handle(), stop_flag);
         listen_thread->join();
         delete listen_thread;
         listen_thread = nullptr;
-        stop_mutex.unlock();
         return true;
     }
-    stop_mutex.unlock();
     return false;
 }
 
@@ -100,8 +258,11 @@ void multipipe::write(const char* bytes, size_t count, set<int>& src) {
         }
     }
 
-    if (mode == write_mode)
+    if (mode == write_mode) {
+        if (inspector)
+            inspector(bytes, count);
         core_pipe->write(bytes, count);
+    }
 
     write_mutex.unlock();
 }
@@ -115,6 +276,13 @@ void multipipe::close_and_notify() {
         disconnect(pipe.second);
 
     core_pipe->close();
+
+    std::lock_guard<mutex> lock(write_mutex);
+    if (inspector) {
+        auto func = inspector;
+        inspector = nullptr;
+        func(nullptr, 0);
+    }
 }
 
 void multipipe::flush() {
@@ -125,7 +293,7 @@ void multipipe::flush() {
 }
 
 multipipe_ptr multipipe::open_std(std_stream_type type, bool flush, int buffer_size) {
-    return multipipe_ptr(new multipipe(system_pipe::open_std(type, flush), buffer_size, type == std_stream_input ? read_mode : write_mode));
+    return multipipe_ptr(new multipipe(system_pipe::open_std(type, flush), buffer_size, type == std_stream_input ? read_mode : write_mode, false));
 }
 
 multipipe_ptr multipipe::create_pipe(pipe_mode mode, bool flush, int buffer_size) {
@@ -140,6 +308,10 @@ multipipe_ptr multipipe::create_file(const string& filename, bool flush, bool ex
     return multipipe_ptr(new multipipe(system_pipe::open_file(filename, write_mode, flush, excl), buffer_size, write_mode));
 }
 
+multipipe_ptr multipipe::adopt_file(pipe_handle handle, int buffer_size) {
+    return multipipe_ptr(new multipipe(system_pipe::adopt_file(handle), buffer_size, read_mode, false));
+}
+
 multipipe::~multipipe() {
     finalize();
     delete read_buffer;
@@ -147,9 +319,21 @@ multipipe::~multipipe() {
 }
 
 void multipipe::start_read() {
-    if (mode != read_mode || listen_thread != nullptr)
+    std::lock_guard<mutex> lock(stop_mutex);
+    if (mode != read_mode || listen_thread != nullptr || reactor_listening)
         return;
 
+    if (process_message == nullptr) {
+        process_message = [=](const char* buf, size_t count) { write(buf, count); };
+    }
+
+#if defined(__linux__)
+    // Regular files can't be polled and stay with a thread.
+    reactor_listening = pipes_reactor().add(core_pipe->get_input_handle(), EPOLLIN | EPOLLONESHOT,
+        [this](uint32_t) { on_readable(); });
+    if (reactor_listening)
+        return;
+#endif
     listen_thread = new thread(&multipipe::listen, this);
 }
 
@@ -168,6 +352,7 @@ void multipipe::connect(weak_ptr<multipipe> pipe) {
         sinks[p->id] = pipe;
         p->parents_count++;
     }
+    TOPOLOGY_COUNTER++;
     set_new_line_checking();
 }
 
@@ -177,6 +362,7 @@ void multipipe::disconnect(weak_ptr<multipipe> pipe) {
         p->parents_count--;
         p->check_parents();
     }
+    TOPOLOGY_COUNTER++;
     set_new_line_checking();
 }
 
@@ -196,6 +382,15 @@ void multipipe::write(const char* bytes, size_t count) {
 void multipipe::set_custom_process_message(std::function<void(const char* buffer, size_t count)> func) {
     process_message = func;
     custom_process_message = true;
+    check_new_line = true;
+    // makes the reactor reconsider who reads the pipe
+    topology = -1;
+}
+
+void multipipe::set_inspector(std::function<void(const char* buffer, size_t count)> func) {
+    inspector = func;
+    inspected = true;
+    TOPOLOGY_COUNTER++;
 }
 
 bool multipipe::process_message_is_custom() const {
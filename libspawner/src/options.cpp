@@ -1,9 +1,13 @@
 #include "options.h"
 
 #include <algorithm>
+#include <cctype>
+#include <cstdlib>
 #include <iterator>
 #include <regex>
 
+#include "stream_capture.h"
+
 // TODO: use c_list /dev/null || nul system dependent
 const std::string CLEAR_STRING = "*null";
 const options_class::redirect_flags options_class::file_default = { false, false };
@@ -104,12 +108,34 @@ bool options_class::parse_redirect(std::string redirect_string, redirect_flags &
                 if (!full_match[1].matched) { // no have flags
                     PANIC((std::string("Bad redirect: ") + redirect_string).c_str());
                 }
+                if (full_match[2] == "hash" && full_match[9] == "") {
+                    redirect_result.type = hash;
+                    return true;
+                }
+                if (full_match[2] == "capture") {
+                    std::string limit = full_match[9];
+                    redirect_result.type = capture;
+                    redirect_result.capture_limit = stream_capture_class::DEFAULT_LIMIT;
+                    if (limit.length()) {
+                        char* end;
+                        redirect_result.capture_limit = strtoul(limit.c_str(), &end, 10);
+                        if (*end || !isdigit(limit[0])) {
+                            PANIC((std::string("Bad redirect: ") + redirect_string).c_str());
+                        }
+                    }
+                    return true;
+                }
                 if (full_match[9] == "") { // set global flags
                     parse_flags(full_match[2], global_flags, file_default, global_flags);
                     return false; // no save redirect
                 }
-                redirect_result.type = file;
                 redirect_result.name = full_match[9];
+                if (full_match[2] == "cmp" || full_match[2] == "cmp-lines") {
+                    redirect_result.type = compare;
+                    redirect_result.compare_lines = full_match[2] == "cmp-lines";
+                    return true;
+                }
+                redirect_result.type = file;
                 parse_flags(full_match[2], global_flags, file_default, redirect_result.flags);
             }
             else if (full_match[5].matched) { // pipe redirects
@@ -151,7 +177,7 @@ void options_class::add_std(std::vector<redirect> &dst, redirect_flags &global_f
     redirect stream_redirect;
     if (parse_redirect(redirect_str, global_flags, stream_redirect)) {
         for (auto &stream : dst) {
-            if (stream.name == stream_redirect.name) {
+            if (stream.type == stream_redirect.type && stream.name == stream_redirect.name) {
                 stream.flags.apply(stream_redirect.flags);
                 return;
             }
@@ -188,6 +214,22 @@ void options_class::add_environment_variable(const std::string &envStr) {
     environmentVars.push_back(std::make_pair(name, val));
 }
 
+void options_class::set_sandbox_pool(const std::string &count) {
+    char *end;
+    sandbox_pool = strtoul(count.c_str(), &end, 10);
+    if (count.empty() || *end != '\0') {
+        PANIC((std::string("Bad number of sandboxes: ") + count).c_str());
+    }
+}
+
+void options_class::set_cgroup_cpus(const std::string &count) {
+    char *end;
+    cgroup_cpus = strtoul(count.c_str(), &end, 10);
+    if (count.empty() || *end != '\0') {
+        PANIC((std::string("Bad number of cgroup cpus: ") + count).c_str());
+    }
+}
+
 //TODO: rethink this
 void options_class::clear_stdinput() {
     stdinput.clear();
@@ -48,7 +48,8 @@ void delegate_runner::create_process() {
         { restriction_write_limit, "B" },
         { restriction_load_ratio, "" },
         { restriction_idle_time_limit, "us" },
-        { restriction_processes_count_limit, "" }
+        { restriction_processes_count_limit, "" },
+        { restriction_instructions_limit, "" }
     };
 
     const std::map< restriction_kind_t, std::string > cmd_arg = {
@@ -59,7 +60,8 @@ void delegate_runner::create_process() {
         { restriction_write_limit, "wl" },
         { restriction_load_ratio, "lr" },
         { restriction_idle_time_limit, "y" },
-        { restriction_processes_count_limit, "only-process" }
+        { restriction_processes_count_limit, "only-process" },
+        { restriction_instructions_limit, "il" }
     };
 
     for (int i = 0; i < restriction_max; ++i)
@@ -99,6 +101,29 @@ void delegate_runner::create_process() {
 
     options.push_argument_front("-wd=" + working_directory);
 
+    if (!options.cgroup_root.empty())
+        options.push_argument_front("--cgroup=" + options.cgroup_root);
+
+    if (options.cgroup_cpus > 0)
+        options.push_argument_front("--cgroup-cpus=" + std::to_string(options.cgroup_cpus));
+
+    options.push_argument_front("--spawn-engine=" + options.spawn_engine);
+
+    if (!options.cpus.empty())
+        options.push_argument_front("--cpus=" + options.cpus);
+
+    if (options.skip_smt_siblings)
+        options.push_argument_front("--skip-smt-siblings=1");
+
+    if (options.perf_counters)
+        options.push_argument_front("--perf-counters=1");
+
+    if (options.sandbox_pool > 0)
+        options.push_argument_front("--isolate=" + std::to_string(options.sandbox_pool));
+
+    if (!options.seccomp_profile.empty())
+        options.push_argument_front("--seccomp-profile=" + options.seccomp_profile);
+
     if (options.hide_report)
     {
         options.push_argument_front("-hr=1");
@@ -0,0 +1,90 @@
+#include "environment_block.h"
+
+#include <map>
+#include <mutex>
+
+#include "inc/error.h"
+
+extern char **environ;
+
+// distinct blocks are few, a long running spawner with ever new variables
+// just starts over
+static const size_t max_cached_blocks = 64;
+
+std::shared_ptr<const environment_block_class> environment_block_class::get(const std::string &mode, const variables_t &variables)
+{
+    // '\0' can't appear in names and values
+    std::string key = mode;
+    for (const auto &variable : variables) {
+        key.push_back('\0');
+        key += variable.first;
+        key.push_back('\0');
+        key += variable.second;
+    }
+
+    static std::mutex cache_mutex;
+    static std::map<std::string, std::shared_ptr<const environment_block_class>> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto cached = cache.find(key);
+    if (cached != cache.end())
+        return cached->second;
+
+    std::shared_ptr<const environment_block_class> block(new environment_block_class(mode, variables));
+    if (cache.size() >= max_cached_blocks)
+        cache.clear();
+    cache[key] = block;
+    return block;
+}
+
+environment_block_class::environment_block_class(const std::string &mode, const variables_t &variables)
+{
+    // name -> value, in the order of first appearance
+    std::vector<std::pair<std::string, std::string>> environment;
+    std::map<std::string, size_t> index;
+    auto set_variable = [&](const std::string &name, const std::string &value) {
+        auto variable = index.find(name);
+        if (variable != index.end()) {
+            environment[variable->second].second = value;
+        } else {
+            index[name] = environment.size();
+            environment.push_back(std::make_pair(name, value));
+        }
+    };
+
+    if (mode == "user-default") {
+        PANIC("user-default mode is not supported");
+    } else if (mode == "clear" || mode == "inherit") {
+        for (char **envp = environ; *envp; envp++) {
+            std::string variable(*envp);
+            size_t pos = variable.find('=');
+            set_variable(variable.substr(0, pos), mode == "clear" || pos == std::string::npos ? "" : variable.substr(pos + 1));
+        }
+    }
+
+    for (const auto &variable : variables)
+        set_variable(variable.first, variable.second);
+
+    size_t size = 0;
+    for (const auto &variable : environment)
+        size += variable.first.size() + variable.second.size() + 2;
+    arena.reserve(size);
+    std::vector<size_t> offsets;
+    for (const auto &variable : environment) {
+        offsets.push_back(arena.size());
+        arena.insert(arena.end(), variable.first.begin(), variable.first.end());
+        arena.push_back('=');
+        arena.insert(arena.end(), variable.second.begin(), variable.second.end());
+        arena.push_back('\0');
+    }
+
+    for (size_t offset : offsets)
+        pointers.push_back(arena.data() + offset);
+    pointers.push_back(nullptr);
+}
+
+char **environment_block_class::data() const
+{
+    // execve() takes char *const[], the strings are never written to
+    return const_cast<char **>(pointers.data());
+}
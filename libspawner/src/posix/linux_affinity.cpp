@@ -1,9 +1,184 @@
 #include "linux_affinity.h"
 
-bool linux_affinity_class::set(pid_t p)
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "logger.h"
+
+// One per user, a directory shared with other users could be taken over
+// by whoever made it first.
+static std::string lock_directory()
+{
+    return "/tmp/spawner-cpus-" + std::to_string(geteuid());
+}
+
+// Parses "0-3,8" into mask.
+static bool parse_cpu_list(const std::string &list, cpu_set_t &mask)
+{
+    CPU_ZERO(&mask);
+    const char *p = list.c_str();
+    while (*p) {
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (end == p)
+            return false;
+        p = end;
+        if (*p == '-') {
+            last = strtol(++p, &end, 10);
+            if (end == p)
+                return false;
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+            return false;
+        for (long cpu = first; cpu <= last; cpu++)
+            CPU_SET(cpu, &mask);
+        if (*p == ',')
+            p++;
+        else if (*p)
+            return false;
+    }
+    return true;
+}
+
+// The first cpu of the physical core the given one belongs to.
+static int first_smt_sibling(int cpu)
+{
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list";
+    FILE *file = fopen(path.c_str(), "re");
+    if (file == nullptr)
+        return cpu;
+    int first = cpu;
+    if (fscanf(file, "%d", &first) != 1)
+        first = cpu;
+    fclose(file);
+    return first;
+}
+
+linux_affinity_class::linux_affinity_class()
 {
     CPU_ZERO(&cpumask);
-    CPU_SET(0, &cpumask); // add only a first core
-    
-    return ((sched_setaffinity(p, sizeof(cpumask), &cpumask) != -1)) ? 1 : 0;
+}
+
+linux_affinity_class::~linux_affinity_class()
+{
+    release();
+}
+
+// Whatever is in the directory is only opened, never followed or blocked
+// on, and has to be a regular file.
+static int open_lock_file(const std::string &path)
+{
+    const int flags = O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK;
+    for (;;) {
+        // read only is enough for flock() and works on files of other users,
+        // O_CREAT would not with fs.protected_regular
+        int fd = open(path.c_str(), flags);
+        if (fd == -1 && errno == ENOENT)
+            fd = open(path.c_str(), flags | O_CREAT | O_EXCL, 0644);
+        if (fd == -1 && errno == EEXIST)
+            continue;
+        if (fd == -1)
+            return -1;
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) == -1 || !S_ISREG(file_stat.st_mode)) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+// The name is known in advance, so another user may have made it already;
+// it is used only if it belongs to this user and nobody else can write to it.
+static bool prepare_lock_directory(const std::string &directory)
+{
+    if (mkdir(directory.c_str(), 0700) == -1 && errno != EEXIST)
+        return false;
+    struct stat directory_stat;
+    if (lstat(directory.c_str(), &directory_stat) == -1 || !S_ISDIR(directory_stat.st_mode))
+        return false;
+    if (directory_stat.st_uid != geteuid())
+        return false;
+    if (directory_stat.st_mode & (S_IWGRP | S_IWOTH))
+        return false;
+    return true;
+}
+
+bool linux_affinity_class::try_lock(int candidate)
+{
+    std::string path = lock_directory() + "/cpu" + std::to_string(candidate);
+    int fd = open_lock_file(path);
+    if (fd == -1)
+        return false;
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        close(fd);
+        return false;
+    }
+    lock_fd = fd;
+    cpu = candidate;
+    return true;
+}
+
+bool linux_affinity_class::reserve(const std::string &cpus, bool skip_smt_siblings)
+{
+    release();
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+        CPU_ZERO(&allowed);
+    if (!cpus.empty()) {
+        cpu_set_t requested;
+        if (!parse_cpu_list(cpus, requested))
+            return false;
+        CPU_AND(&allowed, &allowed, &requested);
+        if (CPU_COUNT(&allowed) == 0)
+            return false;
+    }
+
+    // shared by all sp processes of this user
+    const std::string directory = lock_directory();
+    bool lockable = prepare_lock_directory(directory);
+    if (!lockable)
+        LOG("cpu pinning is disabled, can't use the lock directory", directory);
+
+    for (int candidate = 0; lockable && candidate < CPU_SETSIZE; candidate++) {
+        if (!CPU_ISSET(candidate, &allowed))
+            continue;
+        if (skip_smt_siblings && first_smt_sibling(candidate) != candidate)
+            continue;
+        if (try_lock(candidate)) {
+            CPU_ZERO(&cpumask);
+            CPU_SET(candidate, &cpumask);
+            return true;
+        }
+    }
+
+    cpumask = allowed;
+    return true;
+}
+
+void linux_affinity_class::release()
+{
+    if (lock_fd != -1)
+        close(lock_fd);
+    lock_fd = -1;
+    cpu = -1;
+}
+
+bool linux_affinity_class::set(pid_t p)
+{
+    if (CPU_COUNT(&cpumask) == 0)
+        return true;
+    return sched_setaffinity(p, sizeof(cpumask), &cpumask) != -1;
+}
+
+int linux_affinity_class::get_cpu() const
+{
+    return cpu;
 }
@@ -0,0 +1,232 @@
+#include "linux_cgroup.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "linux_reactor.h"
+
+cgroup_class::cgroup_class()
+{
+}
+
+cgroup_class::~cgroup_class()
+{
+    destroy();
+}
+
+bool cgroup_class::create(const std::string &root, const std::string &name)
+{
+    destroy();
+
+    std::string leaf = root + "/" + name;
+    if (mkdir(leaf.c_str(), 0755) == -1 && errno != EEXIST)
+        return false;
+    path = leaf;
+    procs_fd = open((path + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+    // the child could not be moved in, the cgroup is of no use
+    if (procs_fd == -1) {
+        int error = errno;
+        destroy();
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+void cgroup_class::destroy()
+{
+    if (oom_watch) {
+        reactor_class::instance().remove(oom_watch->inotify_fd);
+        {
+            // a handler being run by the reactor finishes before we go on
+            std::lock_guard<std::mutex> lock(oom_watch->handler_mutex);
+            oom_watch->handler = nullptr;
+        }
+        close(oom_watch->inotify_fd);
+        oom_watch.reset();
+    }
+
+    if (procs_fd != -1) {
+        close(procs_fd);
+        procs_fd = -1;
+    }
+
+    if (path.empty())
+        return;
+
+    // cgroup.kill appeared in 5.14, processes left on older kernels keep
+    // the directory busy and it stays behind
+    write_file("cgroup.kill", "1");
+    for (int attempt = 0; attempt < 100; attempt++) {
+        if (rmdir(path.c_str()) == 0 || errno != EBUSY)
+            break;
+        usleep(1000);
+    }
+    path.clear();
+}
+
+bool cgroup_class::is_active() const
+{
+    return !path.empty();
+}
+
+const std::string &cgroup_class::get_path() const
+{
+    return path;
+}
+
+bool cgroup_class::attach(pid_t pid)
+{
+    return write_file("cgroup.procs", std::to_string(pid));
+}
+
+bool cgroup_class::attach_self()
+{
+    // "0" stands for the writer itself
+    return procs_fd != -1 && write(procs_fd, "0", 1) == 1;
+}
+
+bool cgroup_class::set_memory_limit(uint64_t bytes)
+{
+    if (!write_file("memory.max", std::to_string(bytes)))
+        return false;
+    // swap would let the process exceed the limit unnoticed
+    write_file("memory.swap.max", "0");
+    // kill the whole group instead of a random member
+    write_file("memory.oom.group", "1");
+    return true;
+}
+
+bool cgroup_class::set_pids_limit(uint64_t count)
+{
+    return write_file("pids.max", std::to_string(count));
+}
+
+bool cgroup_class::set_cpu_limit(uint64_t cpus, uint64_t period_us)
+{
+    return write_file("cpu.max", std::to_string(cpus * period_us) + " " + std::to_string(period_us));
+}
+
+bool cgroup_class::watch_oom(const oom_handler_t &handler)
+{
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd == -1)
+        return false;
+    if (inotify_add_watch(fd, (path + "/memory.events").c_str(), IN_MODIFY) == -1) {
+        close(fd);
+        return false;
+    }
+
+    std::shared_ptr<oom_watch_t> watch = std::make_shared<oom_watch_t>();
+    watch->inotify_fd = fd;
+    watch->handler = handler;
+
+    std::string events_file = path + "/memory.events";
+    bool added = reactor_class::instance().add(fd, EPOLLIN, [watch, events_file](uint32_t) {
+        char buffer[4096];
+        while (read(watch->inotify_fd, buffer, sizeof(buffer)) > 0);
+
+        std::lock_guard<std::mutex> lock(watch->handler_mutex);
+        if (!watch->handler)
+            return;
+
+        int events_fd = open(events_file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (events_fd == -1)
+            return;
+        int len = read(events_fd, buffer, sizeof(buffer) - 1);
+        close(events_fd);
+        if (len <= 0)
+            return;
+        buffer[len] = '\0';
+
+        const char *needle = strstr(buffer, "oom_kill ");
+        if (needle == nullptr)
+            return;
+        uint64_t kills = strtoull(needle + strlen("oom_kill "), nullptr, 10);
+        if (kills > watch->reported) {
+            watch->reported = kills;
+            watch->handler();
+        }
+    });
+    if (!added) {
+        close(fd);
+        return false;
+    }
+
+    oom_watch = watch;
+    return true;
+}
+
+bool cgroup_class::read_memory_peak(uint64_t &bytes) const
+{
+    // memory.peak appeared in 5.19
+    std::string value;
+    if (!read_file("memory.peak", value))
+        return false;
+    bytes = strtoull(value.c_str(), nullptr, 10);
+    return true;
+}
+
+bool cgroup_class::read_cpu_usage(uint64_t &usage_us, uint64_t &user_us, uint64_t &system_us) const
+{
+    return read_key("cpu.stat", "usage_usec", usage_us)
+        && read_key("cpu.stat", "user_usec", user_us)
+        && read_key("cpu.stat", "system_usec", system_us);
+}
+
+uint64_t cgroup_class::read_oom_kills() const
+{
+    uint64_t kills = 0;
+    read_key("memory.events", "oom_kill", kills);
+    return kills;
+}
+
+bool cgroup_class::write_file(const std::string &file, const std::string &value) const
+{
+    int fd = open((path + "/" + file).c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    bool result = write(fd, value.c_str(), value.size()) == (ssize_t)value.size();
+    close(fd);
+    return result;
+}
+
+bool cgroup_class::read_file(const std::string &file, std::string &value) const
+{
+    int fd = open((path + "/" + file).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    char buffer[4096];
+    int len = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if (len < 0)
+        return false;
+    value.assign(buffer, len);
+    return true;
+}
+
+bool cgroup_class::read_key(const std::string &file, const char *key, uint64_t &value) const
+{
+    // flat keyed files: "<key> <value>\n" per line
+    std::string contents;
+    if (!read_file(file, contents))
+        return false;
+    size_t key_len = strlen(key);
+    for (size_t line = 0; line < contents.size();) {
+        if (contents.compare(line, key_len, key) == 0 && contents[line + key_len] == ' ') {
+            value = strtoull(contents.c_str() + line + key_len + 1, nullptr, 10);
+            return true;
+        }
+        line = contents.find('\n', line);
+        if (line == std::string::npos)
+            break;
+        line++;
+    }
+    return false;
+}
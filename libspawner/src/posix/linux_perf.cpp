@@ -0,0 +1,85 @@
+#include "linux_perf.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+static int open_counter(pid_t pid, uint32_t type, uint64_t config, bool before_exec)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.inherit = 1;
+    // perf_event_paranoid 2, the default, allows user space only
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.disabled = before_exec;
+    attr.enable_on_exec = before_exec;
+    return syscall(__NR_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+static bool read_counter(int fd, uint64_t &value)
+{
+    return fd != -1 && read(fd, &value, sizeof(value)) == sizeof(value);
+}
+
+perf_counters_class::perf_counters_class()
+{
+}
+
+perf_counters_class::~perf_counters_class()
+{
+    close();
+}
+
+bool perf_counters_class::instructions_supported()
+{
+    static const bool supported = []() {
+        int fd = open_counter(0, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, true);
+        if (fd == -1)
+            return false;
+        ::close(fd);
+        return true;
+    }();
+    return supported;
+}
+
+void perf_counters_class::open(pid_t pid, bool before_exec)
+{
+    close();
+    task_clock_fd = open_counter(pid, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, before_exec);
+    if (instructions_supported())
+        instructions_fd = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, before_exec);
+}
+
+void perf_counters_class::close()
+{
+    if (instructions_fd != -1)
+        ::close(instructions_fd);
+    if (task_clock_fd != -1)
+        ::close(task_clock_fd);
+    instructions_fd = task_clock_fd = -1;
+}
+
+bool perf_counters_class::counts_instructions() const
+{
+    return instructions_fd != -1;
+}
+
+bool perf_counters_class::counts_task_clock() const
+{
+    return task_clock_fd != -1;
+}
+
+bool perf_counters_class::read_instructions(uint64_t &count) const
+{
+    return read_counter(instructions_fd, count);
+}
+
+bool perf_counters_class::read_task_clock(uint64_t &nanoseconds) const
+{
+    return read_counter(task_clock_fd, nanoseconds);
+}
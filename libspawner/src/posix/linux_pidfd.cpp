@@ -0,0 +1,185 @@
+#include "linux_pidfd.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "inc/error.h"
+
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+// glibc prior to 2.36 does not know about P_PIDFD
+#define WAIT_P_PIDFD 3
+
+static int sigchld_write_fd = -1;
+
+static void sigchld_handler(int)
+{
+    int saved_errno = errno;
+    char c = 0;
+    if (write(sigchld_write_fd, &c, 1) == -1) {
+        // pipe is full, a wakeup is already pending
+    }
+    errno = saved_errno;
+}
+
+// Converts waitid() result to the status format of waitpid()
+static int siginfo_to_status(const siginfo_t &info)
+{
+    switch (info.si_code) {
+    case CLD_EXITED:
+        return (info.si_status & 0xff) << 8;
+    case CLD_KILLED:
+        return info.si_status & 0x7f;
+    case CLD_DUMPED:
+        return (info.si_status & 0x7f) | 0x80;
+    case CLD_STOPPED:
+    case CLD_TRAPPED:
+        return ((info.si_status & 0xff) << 8) | 0x7f;
+    case CLD_CONTINUED:
+        return 0xffff;
+    default:
+        return 0;
+    }
+}
+
+pidfd_watch_class &pidfd_watch_class::instance()
+{
+    static pidfd_watch_class watch_instance;
+    return watch_instance;
+}
+
+pidfd_watch_class::pidfd_watch_class()
+    : reactor(1)
+{
+    if (pipe2(sigchld_pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+        PANIC(strerror(errno));
+    sigchld_write_fd = sigchld_pipe[1];
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = sigchld_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGCHLD, &sa, nullptr) == -1)
+        PANIC(strerror(errno));
+
+    reactor.add(sigchld_pipe[0], EPOLLIN, [this](uint32_t) {
+        char buffer[64];
+        while (read(sigchld_pipe[0], buffer, sizeof(buffer)) > 0);
+        poll_all();
+    });
+}
+
+pidfd_watch_class::~pidfd_watch_class()
+{
+    signal(SIGCHLD, SIG_DFL);
+    // the members are destroyed after the body, so the worker must not outlive it
+    reactor.stop();
+    reactor.remove(sigchld_pipe[0]);
+    close(sigchld_pipe[0]);
+    close(sigchld_pipe[1]);
+    for (const auto &watch : watches)
+        close(watch.first);
+}
+
+bool pidfd_watch_class::watch(pid_t pid, const handler_t &handler)
+{
+    int pidfd = syscall(__NR_pidfd_open, pid, 0);
+    if (pidfd == -1)
+        return false;
+
+    std::lock_guard<std::mutex> lock(watches_mutex);
+
+    watch_t &watch = watches[pidfd];
+    watch.pid = pid;
+    watch.handler = handler;
+
+    // the child may have changed its state before the pidfd was opened
+    bool gone = false;
+    if (!poll(pidfd, watch, gone)) {
+        // waitid(P_PIDFD) appeared later than pidfd_open()
+        watches.erase(pidfd);
+        close(pidfd);
+        return false;
+    }
+    if (gone) {
+        watches.erase(pidfd);
+        close(pidfd);
+        return true;
+    }
+
+    if (!reactor.add(pidfd, EPOLLIN, [this, pidfd](uint32_t) { poll(pidfd); }))
+        PANIC(strerror(errno));
+
+    return true;
+}
+
+bool pidfd_watch_class::poll(int pidfd, watch_t &watch, bool &gone)
+{
+    gone = false;
+    while (!gone) {
+        siginfo_t info;
+        memset(&info, 0, sizeof(info));
+        // the raw syscall takes a rusage, the glibc wrapper doesn't
+        struct rusage usage;
+        memset(&usage, 0, sizeof(usage));
+        if (syscall(SYS_waitid, WAIT_P_PIDFD, pidfd, &info,
+            WEXITED | WSTOPPED | WCONTINUED | WNOHANG, &usage) == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EINVAL || errno == ENOSYS)
+                return false;
+            // ECHILD: somebody else has reaped the child
+            gone = true;
+            break;
+        }
+        if (info.si_pid == 0)
+            break;
+
+        gone = info.si_code == CLD_EXITED || info.si_code == CLD_KILLED || info.si_code == CLD_DUMPED;
+        watch.handler(siginfo_to_status(info), usage);
+    }
+    return true;
+}
+
+void pidfd_watch_class::poll(int pidfd)
+{
+    std::lock_guard<std::mutex> lock(watches_mutex);
+
+    auto watch = watches.find(pidfd);
+    if (watch == watches.end())
+        return;
+
+    bool gone;
+    poll(pidfd, watch->second, gone);
+    if (gone) {
+        reactor.remove(pidfd);
+        close(pidfd);
+        watches.erase(watch);
+    }
+}
+
+void pidfd_watch_class::poll_all()
+{
+    std::lock_guard<std::mutex> lock(watches_mutex);
+
+    for (auto watch = watches.begin(); watch != watches.end();) {
+        bool gone;
+        poll(watch->first, watch->second, gone);
+        if (gone) {
+            reactor.remove(watch->first);
+            close(watch->first);
+            watch = watches.erase(watch);
+        } else {
+            ++watch;
+        }
+    }
+}
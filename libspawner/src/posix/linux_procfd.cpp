@@ -1,18 +1,36 @@
 #include "linux_procfd.h"
 
 #include <cstdio>
+#include <cstdlib>
+#include <errno.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <sys/syscall.h>
+
+#ifndef CLOSE_RANGE_CLOEXEC
+#define CLOSE_RANGE_CLOEXEC (1U << 2)
+#endif
 
 void procfd_class::close_all_pipes_without_std() {
+    const unsigned first_fd = STDERR_FILENO + 1; // save stdin(0) stdout(1) stderr(2)
+#if defined(SYS_close_range)
+    // descriptors the child still uses before exec stay open until then
+    if (syscall(SYS_close_range, first_fd, ~0U, CLOSE_RANGE_CLOEXEC) == 0)
+        return;
+    // CLOSE_RANGE_CLOEXEC appeared in 5.11, close_range() itself in 5.9
+    if (errno == EINVAL && syscall(SYS_close_range, first_fd, ~0U, 0) == 0)
+        return;
+#endif
+
     char dir[100];
     std::sprintf(dir, "/proc/%d/fd/", getpid());
 
     auto dp = opendir(dir);
     if (dp != NULL) {
+        int dir_fd = dirfd(dp);
         while (auto ep = readdir (dp)) {
             int piped = atoi(ep->d_name);
-            if (piped > STDERR_FILENO) { // save stdin(0) stdout(1) stderr(2)
+            if (piped >= (int)first_fd && piped != dir_fd) {
                 close(piped); //close other
             }
         }
@@ -10,24 +10,79 @@
 #include <signal.h>
 #include "inc/error.h"
 
+// Parses a decimal number at p, returns the position right after it or
+// nullptr if there are no digits.
+static const char *scan_number(const char *p, const char *end, size_t &value)
+{
+    const char *start = p;
+    size_t result = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        result = result * 10 + (*p++ - '0');
+    if (p == start)
+        return nullptr;
+    value = result;
+    return p;
+}
+
+static int read_file(int fd, char *buffer, size_t size)
+{
+    int len;
+    do {
+        len = pread(fd, buffer, size, 0);
+    } while (len == -1 && errno == EINTR);
+    return len;
+}
+
+procfs_class::~procfs_class()
+{
+    close_files();
+}
+
+void procfs_class::close_files()
+{
+    if (io_fd != -1)
+        close(io_fd);
+    if (stat_fd != -1)
+        close(stat_fd);
+    io_fd = stat_fd = -1;
+}
+
 void procfs_class::probe_pid(pid_t p)
 {
     stat_path = "/proc/" + std::to_string(p) + "/stat";
     io_path = "/proc/" + std::to_string(p) + "/io";
 
-    discovered_stat = access(stat_path.c_str(), R_OK) != -1;
+    close_files();
+
+    stat_fd = open(stat_path.c_str(), O_RDONLY | O_CLOEXEC);
+    discovered_stat = stat_fd != -1;
 
     if (!discovered_stat) {
         kill(p, SIGKILL);
         PANIC(strerror(errno));
     }
 
-    discovered_io = access(io_path.c_str(), R_OK) != -1;
+    io_fd = open(io_path.c_str(), O_RDONLY | O_CLOEXEC);
+    discovered_io = io_fd != -1;
+
+    discovered_cpu_clock = clock_getcpuclockid(p, &cpu_clock) == 0;
 }
 
 bool procfs_class::fill_all()
 {
-    return fill_io() && fill_stat();
+    return fill_io() && fill_stat() && fill_cpu_time();
+}
+
+bool procfs_class::fill_cpu_time() {
+    if (!discovered_cpu_clock)
+        return true;
+
+    struct timespec ts;
+    if (clock_gettime(cpu_clock, &ts) == -1)
+        return false;
+
+    cpu_time = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return true;
 }
 
 bool procfs_class::fill_io() {
@@ -36,86 +91,81 @@ bool procfs_class::fill_io() {
         return true;
     }
 
-    char buffer[4096], *needle;
-    int fd, len;
-    size_t io_read, io_write;
-
-    fd = open(io_path.c_str(), O_RDONLY);
-    if (fd < 0) {
-        disappeared_io = true;
-        return false;
-    }
-    len = read(fd, buffer, sizeof(buffer) - 1);
-    close(fd);
+    char buffer[4096];
+    int len = read_file(io_fd, buffer, sizeof(buffer));
     if (len <= 0) {
         disappeared_io = true;
         return false;
     }
-    buffer[len] = '\0';
 
-/*
-    needle = strstr(buffer, IO_RD_STR);
-    if (needle == nullptr) {
-        disappeared_io = true;
-        return false;
-    }
-    errno = 0;
-    io_read = strtoull(needle + strlen(IO_RD_STR), nullptr, 10);
-    if (errno) {
-        disappeared_io = true;
-        return false;
-    }
-    read_bytes = io_read;
-*/
-
-    needle = strstr(buffer, IO_WR_STR);
-    if (needle == nullptr) {
-        disappeared_io = true;
-        return false;
-    }
-    errno = 0;
-    io_write = strtoull(needle + strlen(IO_WR_STR), nullptr, 10);
-    if (errno) {
-        disappeared_io = true;
-        return false;
+    // lines look like "wchar: 123\n", only wchar is of interest for now
+    static const size_t key_len = sizeof(IO_WR_STR) - 1;
+    const char *end = buffer + len;
+    for (const char *line = buffer; line < end;) {
+        if ((size_t)(end - line) > key_len && memcmp(line, IO_WR_STR, key_len) == 0) {
+            size_t io_write;
+            if (scan_number(line + key_len, end, io_write) == nullptr)
+                break;
+            write_bytes = io_write;
+            return true;
+        }
+        const char *next = (const char *)memchr(line, '\n', end - line);
+        if (next == nullptr)
+            break;
+        line = next + 1;
     }
-    write_bytes = io_write;
 
-    //printf("%lu, %lu\n", io_read, io_write);
-    return true;
+    disappeared_io = true;
+    return false;
 }
 
 bool procfs_class::fill_stat() {
-    char buffer[4096], *token=buffer;
-    size_t utime, stime, vsize, rss;
-    int fd, len, index = 0;
+    char buffer[4096];
+    size_t utime = 0, stime = 0, vsize = 0, rss = 0;
 
-    fd = open(stat_path.c_str(), O_RDONLY);
-    if (fd < 0) {
+    int len = read_file(stat_fd, buffer, sizeof(buffer));
+    if (len <= 0) {
         disappeared_stat = true;
         return false;
     }
-    len = read(fd, buffer, sizeof(buffer) - 1);
-    close(fd);
-    if (len <= 0) {
+
+    // comm (field 1) may contain spaces and parentheses, so fields are
+    // counted from the last ')'
+    const char *end = buffer + len;
+    const char *p = (const char *)memrchr(buffer, ')', len);
+    if (p == nullptr) {
         disappeared_stat = true;
         return false;
     }
-    buffer[len] = '\0';
-    do {
-        errno = 0;
-        switch (index++) {
-        case STAT_UTIME_POS: utime=strtoull(token, nullptr, 10); break;
-        case STAT_STIME_POS: stime=strtoull(token, nullptr, 10); break;
-        case STAT_VSIZE_POS: vsize=strtoull(token, nullptr, 10); break;
-        case STAT_RSS_POS:   rss=strtoull(token, nullptr, 10); break;
-        default: break;
-        }
-        if (errno) {
+    p++;
+
+    for (int index = 2; index <= STAT_LAST; index++) {
+        if (p >= end || *p != ' ') {
             disappeared_stat = true;
             return false;
         }
-    } while ((strsep(&token, " ") != nullptr) || (index <= STAT_LAST));
+        p++;
+
+        size_t *value = nullptr;
+        switch (index) {
+        case STAT_UTIME_POS: value = &utime; break;
+        case STAT_STIME_POS: value = &stime; break;
+        case STAT_VSIZE_POS: value = &vsize; break;
+        case STAT_RSS_POS:   value = &rss; break;
+        default: break;
+        }
+
+        if (value != nullptr) {
+            p = scan_number(p, end, *value);
+            if (p == nullptr) {
+                disappeared_stat = true;
+                return false;
+            }
+        } else {
+            while (p < end && *p != ' ')
+                p++;
+        }
+    }
 
     static const int memory_page_size = sysconf(_SC_PAGESIZE);
 
@@ -126,9 +176,8 @@ bool procfs_class::fill_stat() {
 
     if (vsize > vss_max)
         vss_max = vsize;
-    if (rss > rss_max)
-        rss_max = rss;
-    //printf("%lu %lu %lu %lu\n", utime, stime, vsize, rss);
+    if (stat_rss > rss_max)
+        rss_max = stat_rss;
 
     return true;
 }
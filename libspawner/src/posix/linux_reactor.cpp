@@ -0,0 +1,137 @@
+#include "linux_reactor.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "inc/error.h"
+
+// id 0 is reserved for the wakeup descriptor
+static const uint64_t wakeup_id = 0;
+static const int max_events = 64;
+
+reactor_class::reactor_class(int workers_count)
+    : workers_count(workers_count)
+    , stopping(false)
+    , last_id(wakeup_id)
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1)
+        PANIC(strerror(errno));
+
+    wakeup_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeup_fd == -1)
+        PANIC(strerror(errno));
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = wakeup_id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &ev) == -1)
+        PANIC(strerror(errno));
+}
+
+reactor_class &reactor_class::instance()
+{
+    static reactor_class reactor_instance;
+    return reactor_instance;
+}
+
+reactor_class::~reactor_class()
+{
+    stop();
+    close(wakeup_fd);
+    close(epoll_fd);
+}
+
+void reactor_class::stop()
+{
+    stopping = true;
+    uint64_t one = 1;
+    if (write(wakeup_fd, &one, sizeof(one)) == -1) {
+        // workers will notice the flag on their next wakeup anyway
+    }
+    for (auto &worker : workers) {
+        if (worker.joinable())
+            worker.join();
+    }
+    workers.clear();
+}
+
+bool reactor_class::add(int fd, uint32_t events, const handler_t &handler)
+{
+    std::lock_guard<std::mutex> lock(registrations_mutex);
+
+    uint64_t id = ++last_id;
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = id;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+        return false;
+
+    registrations[id] = { fd, std::make_shared<handler_t>(handler) };
+    ids[fd] = id;
+
+    while (!stopping && (int)workers.size() < workers_count)
+        workers.push_back(std::thread(&reactor_class::worker_body, this));
+
+    return true;
+}
+
+bool reactor_class::rearm(int fd, uint32_t events)
+{
+    std::lock_guard<std::mutex> lock(registrations_mutex);
+
+    auto id = ids.find(fd);
+    if (id == ids.end())
+        return false;
+
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.u64 = id->second;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) != -1;
+}
+
+void reactor_class::remove(int fd)
+{
+    std::lock_guard<std::mutex> lock(registrations_mutex);
+
+    auto id = ids.find(fd);
+    if (id == ids.end())
+        return;
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    // an event already fetched by another worker carries a stale id and is dropped
+    registrations.erase(id->second);
+    ids.erase(id);
+}
+
+void reactor_class::worker_body()
+{
+    struct epoll_event events[max_events];
+
+    while (!stopping) {
+        int count = epoll_wait(epoll_fd, events, max_events, -1);
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+            PANIC(strerror(errno));
+        }
+
+        for (int i = 0; i < count && !stopping; i++) {
+            if (events[i].data.u64 == wakeup_id)
+                continue;
+
+            std::shared_ptr<handler_t> handler;
+            {
+                std::lock_guard<std::mutex> lock(registrations_mutex);
+                auto registration = registrations.find(events[i].data.u64);
+                if (registration == registrations.end())
+                    continue;
+                handler = registration->second.handler;
+            }
+            (*handler)(events[i].events);
+        }
+    }
+}
@@ -0,0 +1,367 @@
+#include "linux_sandbox.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <string.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/ipc.h>
+#include <sys/mount.h>
+#include <sys/msg.h>
+#include <sys/resource.h>
+#include <sys/sem.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <string>
+#include <vector>
+
+#include "error.h"
+
+static const size_t init_stack_size = 64 * 1024;
+
+// the control socket of the init, the only descriptor it keeps
+static const int init_control_fd = 3;
+
+// one byte messages on the control socket
+static const char message_go = 'g';
+static const char message_reset = 'r';
+static const char message_ready = 'k';
+
+static const char *const namespace_names[] = { "user", "mnt", "net", "ipc", "uts", "pid" };
+static const int namespace_types[] = { CLONE_NEWUSER, CLONE_NEWNS, CLONE_NEWNET, CLONE_NEWIPC, CLONE_NEWUTS, CLONE_NEWPID };
+
+static bool send_message(int fd, char message)
+{
+    ssize_t count;
+    do {
+        count = send(fd, &message, 1, MSG_NOSIGNAL);
+    } while (count == -1 && errno == EINTR);
+    return count == 1;
+}
+
+static bool receive_message(int fd, char expected)
+{
+    char message;
+    ssize_t count;
+    do {
+        count = read(fd, &message, 1);
+    } while (count == -1 && errno == EINTR);
+    return count == 1 && message == expected;
+}
+
+static bool write_file(const std::string &path, const std::string &value)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+    bool result = write(fd, value.c_str(), value.size()) == (ssize_t)value.size();
+    close(fd);
+    return result;
+}
+
+sandbox_class::sandbox_class()
+{
+    for (int &fd : namespace_fds)
+        fd = -1;
+}
+
+sandbox_class::~sandbox_class()
+{
+    destroy();
+}
+
+bool sandbox_class::create()
+{
+    destroy();
+
+    int control[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, control) == -1)
+        return false;
+
+    // the init is a copy of the spawner, the stack is copied along
+    std::vector<char> stack(init_stack_size);
+    int flags = CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWNET | CLONE_NEWIPC | CLONE_NEWUTS | CLONE_NEWPID | SIGCHLD;
+    init_pid = clone(init_main, stack.data() + stack.size(), flags, &control[1]);
+    int error = errno;
+    close(control[1]);
+    if (init_pid == -1) {
+        close(control[0]);
+        errno = error;
+        return false;
+    }
+    control_fd = control[0];
+
+    // an unprivileged parent may only map its own ids, and the groups
+    // can't be changed inside then
+    std::string proc = "/proc/" + std::to_string(init_pid);
+    bool mapped = write_file(proc + "/setgroups", "deny")
+        && write_file(proc + "/uid_map", std::to_string(geteuid()) + " " + std::to_string(geteuid()) + " 1")
+        && write_file(proc + "/gid_map", std::to_string(getegid()) + " " + std::to_string(getegid()) + " 1");
+    for (int i = 0; mapped && i < namespace_max; i++) {
+        namespace_fds[i] = open((proc + "/ns/" + namespace_names[i]).c_str(), O_RDONLY | O_CLOEXEC);
+        mapped = namespace_fds[i] != -1;
+    }
+    error = errno;
+
+    if (!mapped || !send_message(control_fd, message_go) || !receive_message(control_fd, message_ready)) {
+        destroy();
+        errno = mapped ? EPERM : error;
+        return false;
+    }
+    return true;
+}
+
+void sandbox_class::destroy()
+{
+    for (int &fd : namespace_fds) {
+        if (fd != -1)
+            close(fd);
+        fd = -1;
+    }
+    if (control_fd != -1) {
+        // the init exits on end of file, taking the namespaces with it
+        close(control_fd);
+        control_fd = -1;
+    }
+    if (init_pid != -1) {
+        kill(init_pid, SIGKILL);
+        while (waitpid(init_pid, nullptr, 0) == -1 && errno == EINTR);
+        init_pid = -1;
+    }
+    resetting = false;
+}
+
+bool sandbox_class::enter() const
+{
+    // the user namespace gives the capabilities to join the others
+    for (int i = 0; i < namespace_max; i++) {
+        if (syscall(SYS_setns, namespace_fds[i], namespace_types[i]) == -1)
+            return false;
+    }
+    return true;
+}
+
+bool sandbox_class::reset()
+{
+    if (control_fd == -1 || !send_message(control_fd, message_reset))
+        return false;
+    resetting = true;
+    return true;
+}
+
+bool sandbox_class::wait_ready()
+{
+    if (control_fd == -1)
+        return false;
+    if (resetting) {
+        resetting = false;
+        return receive_message(control_fd, message_ready);
+    }
+    return true;
+}
+
+bool sandbox_class::is_ready() const
+{
+    if (control_fd == -1 || !resetting)
+        return true;
+    struct pollfd control = { control_fd, POLLIN, 0 };
+    return poll(&control, 1, 0) > 0;
+}
+
+// The init is a copy of a multithreaded process and never execs, it sticks
+// to syscalls.
+int sandbox_class::init_main(void *arg)
+{
+    int control = *(int *)arg;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_DFL;
+    for (int signal = 1; signal < NSIG; signal++)
+        sigaction(signal, &sa, nullptr);
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, nullptr);
+
+    // pipes of other runners must not be kept open by the init
+    if (control != init_control_fd && dup2(control, init_control_fd) == -1)
+        _exit(EXIT_FAILURE);
+#if defined(SYS_close_range)
+    if (syscall(SYS_close_range, init_control_fd + 1, ~0U, 0) == -1)
+#endif
+    {
+        struct rlimit files;
+        rlim_t max_fd = getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur != RLIM_INFINITY ? files.rlim_cur : 65536;
+        for (rlim_t fd = init_control_fd + 1; fd < max_fd; fd++)
+            close((int)fd);
+    }
+
+    // the parent writes the id maps meanwhile
+    if (!receive_message(init_control_fd, message_go) || !set_up_init())
+        _exit(EXIT_FAILURE);
+    send_message(init_control_fd, message_ready);
+
+    char message;
+    for (;;) {
+        ssize_t count = read(init_control_fd, &message, 1);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count != 1)
+            _exit(EXIT_SUCCESS);
+        if (message == message_reset) {
+            clean_up_init();
+            send_message(init_control_fd, message_ready);
+        }
+    }
+}
+
+bool sandbox_class::set_up_init()
+{
+    // mounts of the sandbox don't leak to the host
+    if (mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) == -1)
+        return false;
+    if (mount("proc", "/proc", "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, nullptr) == -1)
+        return false;
+    if (mount("tmpfs", "/dev/shm", "tmpfs", MS_NOSUID | MS_NODEV, "mode=1777") == -1 && errno != ENOENT)
+        return false;
+
+    const char hostname[] = "sandbox";
+    sethostname(hostname, sizeof(hostname) - 1);
+
+    // the loopback interface comes up down
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd != -1) {
+        struct ifreq request;
+        memset(&request, 0, sizeof(request));
+        strncpy(request.ifr_name, "lo", IFNAMSIZ - 1);
+        if (ioctl(fd, SIOCGIFFLAGS, &request) == 0) {
+            request.ifr_flags |= IFF_UP;
+            ioctl(fd, SIOCSIFFLAGS, &request);
+        }
+        close(fd);
+    }
+    return true;
+}
+
+void sandbox_class::clean_up_init()
+{
+    // the init of a pid namespace kills all of it but itself
+    kill(-1, SIGKILL);
+    for (;;) {
+        if (waitpid(-1, nullptr, 0) == -1 && errno != EINTR)
+            break;
+    }
+
+    // the *_STAT commands take an index and give an identifier
+    struct shm_info shm_usage;
+    int max_index = shmctl(0, SHM_INFO, (struct shmid_ds *)&shm_usage);
+    for (int i = 0; i <= max_index; i++) {
+        struct shmid_ds shm;
+        int id = shmctl(i, SHM_STAT, &shm);
+        if (id != -1)
+            shmctl(id, IPC_RMID, nullptr);
+    }
+    struct msginfo msg_usage;
+    max_index = msgctl(0, MSG_INFO, (struct msqid_ds *)&msg_usage);
+    for (int i = 0; i <= max_index; i++) {
+        struct msqid_ds msg;
+        int id = msgctl(i, MSG_STAT, &msg);
+        if (id != -1)
+            msgctl(id, IPC_RMID, nullptr);
+    }
+    struct seminfo sem_usage;
+    max_index = semctl(0, 0, SEM_INFO, &sem_usage);
+    for (int i = 0; i <= max_index; i++) {
+        struct semid_ds sem;
+        int id = semctl(i, 0, SEM_STAT, &sem);
+        if (id != -1)
+            semctl(id, 0, IPC_RMID);
+    }
+
+    if (umount2("/dev/shm", MNT_DETACH) == 0)
+        mount("tmpfs", "/dev/shm", "tmpfs", MS_NOSUID | MS_NODEV, "mode=1777");
+}
+
+sandbox_pool_class &sandbox_pool_class::instance()
+{
+    static sandbox_pool_class pool_instance;
+    return pool_instance;
+}
+
+sandbox_pool_class::sandbox_ptr sandbox_pool_class::acquire(size_t pool_size)
+{
+    bool fill;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        fill = !filled;
+        filled = true;
+    }
+    if (fill) {
+        // the caller takes one more, the pool is full once it is released
+        std::vector<sandbox_ptr> created;
+        for (size_t i = 1; i < pool_size; i++)
+            created.push_back(create_sandbox());
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        for (auto &sandbox : created) {
+            if (ready.size() < pool_size)
+                ready.push_back(sandbox);
+        }
+    }
+
+    for (;;) {
+        sandbox_ptr sandbox;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            sandbox = take_ready();
+        }
+        if (!sandbox)
+            break;
+        // a sandbox whose init is gone is dropped
+        if (sandbox->wait_ready())
+            return sandbox;
+    }
+    return create_sandbox();
+}
+
+void sandbox_pool_class::release(sandbox_ptr sandbox, size_t pool_size)
+{
+    if (!sandbox->reset())
+        return;
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    // the rest is destroyed with the last reference
+    if (ready.size() < pool_size)
+        ready.push_back(sandbox);
+}
+
+sandbox_pool_class::sandbox_ptr sandbox_pool_class::take_ready()
+{
+    if (ready.empty())
+        return nullptr;
+    // the oldest is the most likely to be reset, but one that is certainly
+    // reset goes first
+    auto chosen = ready.begin();
+    for (auto it = ready.begin(); it != ready.end(); ++it) {
+        if ((*it)->is_ready()) {
+            chosen = it;
+            break;
+        }
+    }
+    sandbox_ptr sandbox = *chosen;
+    ready.erase(chosen);
+    return sandbox;
+}
+
+sandbox_pool_class::sandbox_ptr sandbox_pool_class::create_sandbox()
+{
+    sandbox_ptr sandbox = std::make_shared<sandbox_class>();
+    if (!sandbox->create())
+        PANIC(std::string("failed to create namespaces: ") + strerror(errno));
+    return sandbox;
+}
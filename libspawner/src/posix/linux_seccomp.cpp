@@ -1,17 +1,720 @@
 #include "linux_seccomp.h"
 
-int seccomp_probe_filter() {
-    int rval;
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
-    errno = 0;
-    rval = prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, NULL, 0, 0);
+#include <fstream>
+#include <sstream>
+
+#include "error.h"
+
+struct syscall_name_t {
+    const char *name;
+    uint32_t nr;
+};
+
+// names a profile may use, the rest can be given by number
+static const syscall_name_t syscall_names[] = {
+#ifdef __NR_read
+    { "read", __NR_read },
+#endif
+#ifdef __NR_write
+    { "write", __NR_write },
+#endif
+#ifdef __NR_open
+    { "open", __NR_open },
+#endif
+#ifdef __NR_close
+    { "close", __NR_close },
+#endif
+#ifdef __NR_stat
+    { "stat", __NR_stat },
+#endif
+#ifdef __NR_fstat
+    { "fstat", __NR_fstat },
+#endif
+#ifdef __NR_lstat
+    { "lstat", __NR_lstat },
+#endif
+#ifdef __NR_poll
+    { "poll", __NR_poll },
+#endif
+#ifdef __NR_lseek
+    { "lseek", __NR_lseek },
+#endif
+#ifdef __NR_mmap
+    { "mmap", __NR_mmap },
+#endif
+#ifdef __NR_mprotect
+    { "mprotect", __NR_mprotect },
+#endif
+#ifdef __NR_munmap
+    { "munmap", __NR_munmap },
+#endif
+#ifdef __NR_brk
+    { "brk", __NR_brk },
+#endif
+#ifdef __NR_rt_sigaction
+    { "rt_sigaction", __NR_rt_sigaction },
+#endif
+#ifdef __NR_rt_sigprocmask
+    { "rt_sigprocmask", __NR_rt_sigprocmask },
+#endif
+#ifdef __NR_rt_sigreturn
+    { "rt_sigreturn", __NR_rt_sigreturn },
+#endif
+#ifdef __NR_ioctl
+    { "ioctl", __NR_ioctl },
+#endif
+#ifdef __NR_pread64
+    { "pread64", __NR_pread64 },
+#endif
+#ifdef __NR_pwrite64
+    { "pwrite64", __NR_pwrite64 },
+#endif
+#ifdef __NR_readv
+    { "readv", __NR_readv },
+#endif
+#ifdef __NR_writev
+    { "writev", __NR_writev },
+#endif
+#ifdef __NR_access
+    { "access", __NR_access },
+#endif
+#ifdef __NR_pipe
+    { "pipe", __NR_pipe },
+#endif
+#ifdef __NR_select
+    { "select", __NR_select },
+#endif
+#ifdef __NR_sched_yield
+    { "sched_yield", __NR_sched_yield },
+#endif
+#ifdef __NR_mremap
+    { "mremap", __NR_mremap },
+#endif
+#ifdef __NR_msync
+    { "msync", __NR_msync },
+#endif
+#ifdef __NR_mincore
+    { "mincore", __NR_mincore },
+#endif
+#ifdef __NR_madvise
+    { "madvise", __NR_madvise },
+#endif
+#ifdef __NR_dup
+    { "dup", __NR_dup },
+#endif
+#ifdef __NR_dup2
+    { "dup2", __NR_dup2 },
+#endif
+#ifdef __NR_pause
+    { "pause", __NR_pause },
+#endif
+#ifdef __NR_nanosleep
+    { "nanosleep", __NR_nanosleep },
+#endif
+#ifdef __NR_getitimer
+    { "getitimer", __NR_getitimer },
+#endif
+#ifdef __NR_alarm
+    { "alarm", __NR_alarm },
+#endif
+#ifdef __NR_setitimer
+    { "setitimer", __NR_setitimer },
+#endif
+#ifdef __NR_getpid
+    { "getpid", __NR_getpid },
+#endif
+#ifdef __NR_sendfile
+    { "sendfile", __NR_sendfile },
+#endif
+#ifdef __NR_socket
+    { "socket", __NR_socket },
+#endif
+#ifdef __NR_connect
+    { "connect", __NR_connect },
+#endif
+#ifdef __NR_accept
+    { "accept", __NR_accept },
+#endif
+#ifdef __NR_sendto
+    { "sendto", __NR_sendto },
+#endif
+#ifdef __NR_recvfrom
+    { "recvfrom", __NR_recvfrom },
+#endif
+#ifdef __NR_sendmsg
+    { "sendmsg", __NR_sendmsg },
+#endif
+#ifdef __NR_recvmsg
+    { "recvmsg", __NR_recvmsg },
+#endif
+#ifdef __NR_shutdown
+    { "shutdown", __NR_shutdown },
+#endif
+#ifdef __NR_bind
+    { "bind", __NR_bind },
+#endif
+#ifdef __NR_listen
+    { "listen", __NR_listen },
+#endif
+#ifdef __NR_socketpair
+    { "socketpair", __NR_socketpair },
+#endif
+#ifdef __NR_clone
+    { "clone", __NR_clone },
+#endif
+#ifdef __NR_fork
+    { "fork", __NR_fork },
+#endif
+#ifdef __NR_vfork
+    { "vfork", __NR_vfork },
+#endif
+#ifdef __NR_execve
+    { "execve", __NR_execve },
+#endif
+#ifdef __NR_exit
+    { "exit", __NR_exit },
+#endif
+#ifdef __NR_wait4
+    { "wait4", __NR_wait4 },
+#endif
+#ifdef __NR_kill
+    { "kill", __NR_kill },
+#endif
+#ifdef __NR_uname
+    { "uname", __NR_uname },
+#endif
+#ifdef __NR_fcntl
+    { "fcntl", __NR_fcntl },
+#endif
+#ifdef __NR_flock
+    { "flock", __NR_flock },
+#endif
+#ifdef __NR_fsync
+    { "fsync", __NR_fsync },
+#endif
+#ifdef __NR_fdatasync
+    { "fdatasync", __NR_fdatasync },
+#endif
+#ifdef __NR_truncate
+    { "truncate", __NR_truncate },
+#endif
+#ifdef __NR_ftruncate
+    { "ftruncate", __NR_ftruncate },
+#endif
+#ifdef __NR_getdents
+    { "getdents", __NR_getdents },
+#endif
+#ifdef __NR_getcwd
+    { "getcwd", __NR_getcwd },
+#endif
+#ifdef __NR_chdir
+    { "chdir", __NR_chdir },
+#endif
+#ifdef __NR_fchdir
+    { "fchdir", __NR_fchdir },
+#endif
+#ifdef __NR_rename
+    { "rename", __NR_rename },
+#endif
+#ifdef __NR_mkdir
+    { "mkdir", __NR_mkdir },
+#endif
+#ifdef __NR_rmdir
+    { "rmdir", __NR_rmdir },
+#endif
+#ifdef __NR_creat
+    { "creat", __NR_creat },
+#endif
+#ifdef __NR_link
+    { "link", __NR_link },
+#endif
+#ifdef __NR_unlink
+    { "unlink", __NR_unlink },
+#endif
+#ifdef __NR_symlink
+    { "symlink", __NR_symlink },
+#endif
+#ifdef __NR_readlink
+    { "readlink", __NR_readlink },
+#endif
+#ifdef __NR_chmod
+    { "chmod", __NR_chmod },
+#endif
+#ifdef __NR_fchmod
+    { "fchmod", __NR_fchmod },
+#endif
+#ifdef __NR_chown
+    { "chown", __NR_chown },
+#endif
+#ifdef __NR_fchown
+    { "fchown", __NR_fchown },
+#endif
+#ifdef __NR_umask
+    { "umask", __NR_umask },
+#endif
+#ifdef __NR_gettimeofday
+    { "gettimeofday", __NR_gettimeofday },
+#endif
+#ifdef __NR_getrlimit
+    { "getrlimit", __NR_getrlimit },
+#endif
+#ifdef __NR_getrusage
+    { "getrusage", __NR_getrusage },
+#endif
+#ifdef __NR_sysinfo
+    { "sysinfo", __NR_sysinfo },
+#endif
+#ifdef __NR_times
+    { "times", __NR_times },
+#endif
+#ifdef __NR_getuid
+    { "getuid", __NR_getuid },
+#endif
+#ifdef __NR_getgid
+    { "getgid", __NR_getgid },
+#endif
+#ifdef __NR_geteuid
+    { "geteuid", __NR_geteuid },
+#endif
+#ifdef __NR_getegid
+    { "getegid", __NR_getegid },
+#endif
+#ifdef __NR_getppid
+    { "getppid", __NR_getppid },
+#endif
+#ifdef __NR_getpgrp
+    { "getpgrp", __NR_getpgrp },
+#endif
+#ifdef __NR_setsid
+    { "setsid", __NR_setsid },
+#endif
+#ifdef __NR_getgroups
+    { "getgroups", __NR_getgroups },
+#endif
+#ifdef __NR_sigaltstack
+    { "sigaltstack", __NR_sigaltstack },
+#endif
+#ifdef __NR_arch_prctl
+    { "arch_prctl", __NR_arch_prctl },
+#endif
+#ifdef __NR_prctl
+    { "prctl", __NR_prctl },
+#endif
+#ifdef __NR_gettid
+    { "gettid", __NR_gettid },
+#endif
+#ifdef __NR_time
+    { "time", __NR_time },
+#endif
+#ifdef __NR_futex
+    { "futex", __NR_futex },
+#endif
+#ifdef __NR_sched_getaffinity
+    { "sched_getaffinity", __NR_sched_getaffinity },
+#endif
+#ifdef __NR_sched_setaffinity
+    { "sched_setaffinity", __NR_sched_setaffinity },
+#endif
+#ifdef __NR_set_tid_address
+    { "set_tid_address", __NR_set_tid_address },
+#endif
+#ifdef __NR_getdents64
+    { "getdents64", __NR_getdents64 },
+#endif
+#ifdef __NR_fadvise64
+    { "fadvise64", __NR_fadvise64 },
+#endif
+#ifdef __NR_clock_gettime
+    { "clock_gettime", __NR_clock_gettime },
+#endif
+#ifdef __NR_clock_getres
+    { "clock_getres", __NR_clock_getres },
+#endif
+#ifdef __NR_clock_nanosleep
+    { "clock_nanosleep", __NR_clock_nanosleep },
+#endif
+#ifdef __NR_exit_group
+    { "exit_group", __NR_exit_group },
+#endif
+#ifdef __NR_tgkill
+    { "tgkill", __NR_tgkill },
+#endif
+#ifdef __NR_openat
+    { "openat", __NR_openat },
+#endif
+#ifdef __NR_mkdirat
+    { "mkdirat", __NR_mkdirat },
+#endif
+#ifdef __NR_newfstatat
+    { "newfstatat", __NR_newfstatat },
+#endif
+#ifdef __NR_unlinkat
+    { "unlinkat", __NR_unlinkat },
+#endif
+#ifdef __NR_renameat
+    { "renameat", __NR_renameat },
+#endif
+#ifdef __NR_readlinkat
+    { "readlinkat", __NR_readlinkat },
+#endif
+#ifdef __NR_faccessat
+    { "faccessat", __NR_faccessat },
+#endif
+#ifdef __NR_pselect6
+    { "pselect6", __NR_pselect6 },
+#endif
+#ifdef __NR_ppoll
+    { "ppoll", __NR_ppoll },
+#endif
+#ifdef __NR_set_robust_list
+    { "set_robust_list", __NR_set_robust_list },
+#endif
+#ifdef __NR_get_robust_list
+    { "get_robust_list", __NR_get_robust_list },
+#endif
+#ifdef __NR_pipe2
+    { "pipe2", __NR_pipe2 },
+#endif
+#ifdef __NR_dup3
+    { "dup3", __NR_dup3 },
+#endif
+#ifdef __NR_prlimit64
+    { "prlimit64", __NR_prlimit64 },
+#endif
+#ifdef __NR_getrandom
+    { "getrandom", __NR_getrandom },
+#endif
+#ifdef __NR_memfd_create
+    { "memfd_create", __NR_memfd_create },
+#endif
+#ifdef __NR_statx
+    { "statx", __NR_statx },
+#endif
+#ifdef __NR_rseq
+    { "rseq", __NR_rseq },
+#endif
+#ifdef __NR_faccessat2
+    { "faccessat2", __NR_faccessat2 },
+#endif
+#ifdef __NR_close_range
+    { "close_range", __NR_close_range },
+#endif
+#ifdef __NR_execveat
+    { "execveat", __NR_execveat },
+#endif
+#ifdef __NR_epoll_create1
+    { "epoll_create1", __NR_epoll_create1 },
+#endif
+#ifdef __NR_epoll_ctl
+    { "epoll_ctl", __NR_epoll_ctl },
+#endif
+#ifdef __NR_epoll_wait
+    { "epoll_wait", __NR_epoll_wait },
+#endif
+#ifdef __NR_epoll_pwait
+    { "epoll_pwait", __NR_epoll_pwait },
+#endif
+#ifdef __NR_eventfd2
+    { "eventfd2", __NR_eventfd2 },
+#endif
+#ifdef __NR_mlock
+    { "mlock", __NR_mlock },
+#endif
+#ifdef __NR_munlock
+    { "munlock", __NR_munlock },
+#endif
+#ifdef __NR__llseek
+    { "_llseek", __NR__llseek },
+#endif
+#ifdef __NR_mmap2
+    { "mmap2", __NR_mmap2 },
+#endif
+#ifdef __NR_fstat64
+    { "fstat64", __NR_fstat64 },
+#endif
+#ifdef __NR_stat64
+    { "stat64", __NR_stat64 },
+#endif
+#ifdef __NR_lstat64
+    { "lstat64", __NR_lstat64 },
+#endif
+#ifdef __NR_fstatat64
+    { "fstatat64", __NR_fstatat64 },
+#endif
+#ifdef __NR_fcntl64
+    { "fcntl64", __NR_fcntl64 },
+#endif
+#ifdef __NR_getuid32
+    { "getuid32", __NR_getuid32 },
+#endif
+#ifdef __NR_getgid32
+    { "getgid32", __NR_getgid32 },
+#endif
+#ifdef __NR_geteuid32
+    { "geteuid32", __NR_geteuid32 },
+#endif
+#ifdef __NR_getegid32
+    { "getegid32", __NR_getegid32 },
+#endif
+#ifdef __NR_ugetrlimit
+    { "ugetrlimit", __NR_ugetrlimit },
+#endif
+#ifdef __NR_set_thread_area
+    { "set_thread_area", __NR_set_thread_area },
+#endif
+#ifdef __NR_get_thread_area
+    { "get_thread_area", __NR_get_thread_area },
+#endif
+#ifdef __NR_clock_gettime64
+    { "clock_gettime64", __NR_clock_gettime64 },
+#endif
+#ifdef __NR_clock_nanosleep_time64
+    { "clock_nanosleep_time64", __NR_clock_nanosleep_time64 },
+#endif
+#ifdef __NR_futex_time64
+    { "futex_time64", __NR_futex_time64 },
+#endif
+#ifdef __NR_sigreturn
+    { "sigreturn", __NR_sigreturn },
+#endif
+};
+
+// what a program needs to start, use its standard streams and exit
+static const char *const default_syscalls[] = {
+    "rt_sigreturn", "sigreturn", "exit_group", "exit", "read", "write", "readv", "writev",
+    "pread64", "lseek", "_llseek", "rt_sigprocmask", "rt_sigaction", "sigaltstack",
+    "nanosleep", "clock_nanosleep", "clock_nanosleep_time64", "clock_gettime", "clock_gettime64",
+    "clock_getres", "gettimeofday", "time", "brk", "mmap", "mmap2", "munmap", "mremap",
+    "mprotect", "madvise", "execve", "close", "open", "openat", "access", "faccessat",
+    "faccessat2", "readlink", "readlinkat", "fstat", "fstat64", "stat", "stat64", "lstat",
+    "lstat64", "newfstatat", "fstatat64", "statx", "fcntl", "fcntl64", "ioctl", "getrandom",
+    "futex", "futex_time64", "set_tid_address", "set_robust_list", "rseq", "prlimit64",
+    "getrlimit", "ugetrlimit", "uname", "getpid", "gettid", "getuid", "getgid", "geteuid",
+    "getegid", "getuid32", "getgid32", "geteuid32", "getegid32", "sched_getaffinity",
+    "sched_yield", "arch_prctl", "set_thread_area", "get_thread_area",
+};
 
-    // 0 is ok, 1 on failure
-    return ((rval < 0) && (errno == EFAULT)) ? 0 : 1;
+static bool find_syscall(const std::string &name, uint32_t &nr)
+{
+    for (const auto &syscall : syscall_names) {
+        if (name == syscall.name) {
+            nr = syscall.nr;
+            return true;
+        }
+    }
+    char *end;
+    unsigned long number = strtoul(name.c_str(), &end, 10);
+    if (name.empty() || *end != '\0')
+        return false;
+    nr = (uint32_t)number;
+    return true;
 }
 
-int seccomp_setup_filter() {
-    prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+static const size_t max_jump = 255;
+
+// Skips the next `skip` instructions when the condition is `when`. The
+// offsets of conditional jumps are 8 bits, longer ones go through BPF_JA.
+static void emit_jump(std::vector<struct sock_filter> &code, uint16_t op, uint32_t k, bool when, size_t skip)
+{
+    if (skip <= max_jump) {
+        uint8_t offset = (uint8_t)skip;
+        code.push_back(BPF_JUMP(BPF_JMP | op | BPF_K, k, when ? offset : (uint8_t)0, when ? (uint8_t)0 : offset));
+        return;
+    }
+    code.push_back(BPF_JUMP(BPF_JMP | op | BPF_K, k, when ? (uint8_t)0 : (uint8_t)1, when ? (uint8_t)1 : (uint8_t)0));
+    code.push_back(BPF_JUMP(BPF_JMP | BPF_JA, (uint32_t)skip, 0, 0));
+}
+
+static void append(std::vector<struct sock_filter> &code, const std::vector<struct sock_filter> &tail)
+{
+    code.insert(code.end(), tail.begin(), tail.end());
+}
+
+seccomp_filter_class::seccomp_filter_class()
+{
+    for (const char *name : default_syscalls) {
+        // names missing on this architecture are skipped
+        for (const auto &syscall : syscall_names) {
+            if (strcmp(name, syscall.name) == 0) {
+                allow(syscall.nr, rule_t());
+                break;
+            }
+        }
+    }
+}
+
+void seccomp_filter_class::load_profile(const std::string &file)
+{
+    std::ifstream profile(file);
+    if (!profile.is_open())
+        PANIC(file + ": " + strerror(errno));
+    std::string line;
+    for (int line_number = 1; std::getline(profile, line); line_number++)
+        parse_line(line, file + ":" + std::to_string(line_number));
+}
+
+void seccomp_filter_class::parse_line(const std::string &line, const std::string &where)
+{
+    std::istringstream tokens(line.substr(0, line.find('#')));
+    std::string name;
+    if (!(tokens >> name))
+        return;
+    uint32_t nr;
+    if (!find_syscall(name, nr))
+        PANIC(where + ": unknown syscall " + name);
+
+    // argN [& mask] ==|!= value
+    rule_t rule;
+    std::string token;
+    while (tokens >> token) {
+        check_t check;
+        check.mask = ~0ULL;
+        if (token.size() != 4 || token.compare(0, 3, "arg") != 0 || token[3] < '0' || token[3] > '5')
+            PANIC(where + ": expected arg0..arg5 instead of " + token);
+        check.arg = token[3] - '0';
+
+        std::string op, value;
+        if (!(tokens >> op))
+            PANIC(where + ": incomplete check of " + token);
+        if (op == "&") {
+            if (!(tokens >> value) || !(tokens >> op))
+                PANIC(where + ": incomplete check of " + token);
+            char *end;
+            check.mask = strtoull(value.c_str(), &end, 0);
+            if (*end != '\0')
+                PANIC(where + ": bad mask " + value);
+        }
+        if (op != "==" && op != "!=")
+            PANIC(where + ": expected == or != instead of " + op);
+        check.equal = op == "==";
+        if (!(tokens >> value))
+            PANIC(where + ": incomplete check of " + token);
+        char *end;
+        check.value = strtoull(value.c_str(), &end, 0);
+        if (*end != '\0')
+            PANIC(where + ": bad value " + value);
+        rule.push_back(check);
+    }
+    allow(nr, rule);
+}
+
+void seccomp_filter_class::allow(uint32_t nr, const rule_t &rule)
+{
+    std::vector<rule_t> &alternatives = rules[nr];
+    // nothing is left to check once a syscall is allowed unconditionally
+    if (!alternatives.empty() && alternatives.front().empty())
+        return;
+    if (rule.empty())
+        alternatives.clear();
+    alternatives.push_back(rule);
+}
+
+void seccomp_filter_class::compile()
+{
+    program.clear();
+#if defined(ARCH_NR)
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, arch_nr));
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ARCH_NR, 1, 0));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, RESTRICTION_TYPE));
+#endif
+    program.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, syscall_nr));
+#if defined(__x86_64__)
+    // x32 syscalls share the architecture but not the numbers
+    program.push_back(BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, 0x40000000, 0, 1));
+    program.push_back(BPF_STMT(BPF_RET | BPF_K, RESTRICTION_TYPE));
+#endif
+    if (rules.empty())
+        program.push_back(BPF_STMT(BPF_RET | BPF_K, RESTRICTION_TYPE));
+    else
+        append(program, compile_range(rules.begin(), rules.size()));
+    if (program.size() > BPF_MAXINSNS)
+        PANIC("seccomp profile is too large");
+}
+
+std::vector<struct sock_filter> seccomp_filter_class::compile_range(
+    std::map<uint32_t, std::vector<rule_t>>::const_iterator begin, size_t count) const
+{
+    if (count == 1)
+        return compile_syscall(begin->first, begin->second);
+
+    // syscalls below the middle one are on the left
+    auto middle = begin;
+    std::advance(middle, count / 2);
+    std::vector<struct sock_filter> left = compile_range(begin, count / 2);
+    std::vector<struct sock_filter> right = compile_range(middle, count - count / 2);
+
+    std::vector<struct sock_filter> code;
+    emit_jump(code, BPF_JGE, middle->first, true, left.size());
+    append(code, left);
+    append(code, right);
+    return code;
+}
+
+std::vector<struct sock_filter> seccomp_filter_class::compile_syscall(uint32_t nr, const std::vector<rule_t> &alternatives) const
+{
+    // every alternative falls through to the next one when a check fails
+    std::vector<struct sock_filter> body;
+    for (const auto &rule : alternatives)
+        append(body, compile_rule(rule));
+
+    std::vector<struct sock_filter> code;
+    emit_jump(code, BPF_JEQ, nr, false, body.size());
+    append(code, body);
+    code.push_back(BPF_STMT(BPF_RET | BPF_K, RESTRICTION_TYPE));
+    return code;
+}
 
-    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog);
+std::vector<struct sock_filter> seccomp_filter_class::compile_rule(const rule_t &rule) const
+{
+    // built from the end, a failed check skips the rest of the rule
+    std::vector<struct sock_filter> code;
+    code.push_back(BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW));
+
+    for (auto check = rule.rbegin(); check != rule.rend(); ++check) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        const uint32_t low_offset = syscall_args + check->arg * sizeof(uint64_t), high_offset = low_offset + 4;
+#else
+        const uint32_t high_offset = syscall_args + check->arg * sizeof(uint64_t), low_offset = high_offset + 4;
+#endif
+        std::vector<struct sock_filter> low;
+        low.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, low_offset));
+        if ((uint32_t)check->mask != 0xffffffffU)
+            low.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, (uint32_t)check->mask));
+        // == fails on any difference, != fails when both halves are equal
+        emit_jump(low, BPF_JEQ, (uint32_t)(check->value & check->mask), !check->equal, code.size());
+
+        std::vector<struct sock_filter> high;
+        high.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, high_offset));
+        if ((uint32_t)(check->mask >> 32) != 0xffffffffU)
+            high.push_back(BPF_STMT(BPF_ALU | BPF_AND | BPF_K, (uint32_t)(check->mask >> 32)));
+        emit_jump(high, BPF_JEQ, (uint32_t)((check->value & check->mask) >> 32), false,
+            check->equal ? low.size() + code.size() : low.size());
+
+        append(high, low);
+        append(high, code);
+        code.swap(high);
+    }
+    return code;
+}
+
+bool seccomp_filter_class::is_supported()
+{
+    errno = 0;
+    // a filter mode that exists faults on the null program
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, NULL, 0, 0) < 0 && errno == EFAULT;
+}
+
+bool seccomp_filter_class::install() const
+{
+    if (program.empty())
+        return false;
+    struct sock_fprog prog;
+    prog.len = (unsigned short)program.size();
+    prog.filter = const_cast<struct sock_filter *>(program.data());
+    prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+    return prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) == 0;
 }
@@ -0,0 +1,85 @@
+#include "linux_timer.h"
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "linux_reactor.h"
+
+deadline_timer_class::deadline_timer_class()
+{
+}
+
+deadline_timer_class::~deadline_timer_class()
+{
+    stop();
+}
+
+bool deadline_timer_class::start(const handler_t &handler)
+{
+    stop();
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd == -1)
+        return false;
+
+    std::shared_ptr<watch_t> new_watch = std::make_shared<watch_t>();
+    new_watch->timer_fd = fd;
+    new_watch->handler = handler;
+
+    bool added = reactor_class::instance().add(fd, EPOLLIN, [new_watch](uint32_t) {
+        uint64_t expirations;
+        if (read(new_watch->timer_fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+            return;
+
+        std::lock_guard<std::mutex> lock(new_watch->handler_mutex);
+        if (new_watch->handler)
+            new_watch->handler();
+    });
+    if (!added) {
+        close(fd);
+        return false;
+    }
+
+    watch = new_watch;
+    return true;
+}
+
+void deadline_timer_class::stop()
+{
+    if (!watch)
+        return;
+    reactor_class::instance().remove(watch->timer_fd);
+    {
+        std::lock_guard<std::mutex> lock(watch->handler_mutex);
+        watch->handler = nullptr;
+    }
+    close(watch->timer_fd);
+    watch.reset();
+}
+
+bool deadline_timer_class::is_active() const
+{
+    return watch != nullptr;
+}
+
+bool deadline_timer_class::arm_at(uint64_t monotonic_ns)
+{
+    return arm(monotonic_ns, TFD_TIMER_ABSTIME);
+}
+
+bool deadline_timer_class::arm_after(uint64_t delay_ns)
+{
+    // a zero it_value would disarm the timer instead
+    return arm(delay_ns > 0 ? delay_ns : 1, 0);
+}
+
+bool deadline_timer_class::arm(uint64_t ns, int flags)
+{
+    if (!watch)
+        return false;
+    struct itimerspec value = {};
+    value.it_value.tv_sec = ns / 1000000000;
+    value.it_value.tv_nsec = ns % 1000000000;
+    return timerfd_settime(watch->timer_fd, flags, &value, nullptr) == 0;
+}
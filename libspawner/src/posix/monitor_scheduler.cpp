@@ -0,0 +1,181 @@
+#include "monitor_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+monitor_scheduler_class &monitor_scheduler_class::instance()
+{
+    static monitor_scheduler_class scheduler_instance;
+    return scheduler_instance;
+}
+
+monitor_scheduler_class::monitor_scheduler_class()
+    : slots(slots_count)
+    , entries_count(0)
+    , resolution(0)
+    , current_tick(0)
+    , stopping(false)
+    , completions_closed(false)
+{
+}
+
+monitor_scheduler_class::~monitor_scheduler_class()
+{
+    {
+        std::lock_guard<std::mutex> lock(wheel_mutex);
+        stopping = true;
+    }
+    wheel_cond.notify_all();
+    if (scheduler_thread.joinable())
+        scheduler_thread.join();
+    {
+        std::lock_guard<std::mutex> lock(completion_mutex);
+        completions_closed = true;
+    }
+    completion_cond.notify_all();
+    if (completion_thread.joinable())
+        completion_thread.join();
+}
+
+uint64_t monitor_scheduler_class::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void monitor_scheduler_class::add(uint64_t interval, const task_t &task, const done_t &done)
+{
+    interval = std::max<uint64_t>(interval, 1);
+    {
+        std::lock_guard<std::mutex> lock(wheel_mutex);
+
+        intervals.insert(interval);
+        // the wheel may still be as fine as tasks that are gone
+        if (*intervals.begin() != resolution)
+            rebuild(*intervals.begin());
+        else if (entries_count == 0)
+            current_tick = now() / resolution;
+
+        entry_t entry;
+        entry.interval = interval;
+        entry.deadline = now() + interval;
+        entry.task = task;
+        entry.done = done;
+        place(std::move(entry));
+
+        if (!scheduler_thread.joinable()) {
+            completion_thread = std::thread(&monitor_scheduler_class::completion_body, this);
+            scheduler_thread = std::thread(&monitor_scheduler_class::scheduler_body, this);
+        }
+    }
+    wheel_cond.notify_one();
+}
+
+void monitor_scheduler_class::place(entry_t &&entry)
+{
+    uint64_t tick = std::max(entry.deadline / resolution, current_tick);
+    slot_t &slot = slots[tick % slots_count];
+    slot.push_back(std::move(entry));
+    entries_count++;
+}
+
+void monitor_scheduler_class::rebuild(uint64_t new_resolution)
+{
+    slot_t entries;
+    for (auto &slot : slots)
+        entries.splice(entries.end(), slot);
+    entries_count = 0;
+
+    resolution = new_resolution;
+    current_tick = now() / resolution;
+    while (!entries.empty()) {
+        place(std::move(entries.front()));
+        entries.pop_front();
+    }
+}
+
+void monitor_scheduler_class::scheduler_body()
+{
+    std::unique_lock<std::mutex> lock(wheel_mutex);
+
+    while (!stopping) {
+        if (entries_count == 0) {
+            wheel_cond.wait(lock);
+            continue;
+        }
+
+        uint64_t tick_start = current_tick * resolution;
+        uint64_t current_time = now();
+        if (current_time < tick_start) {
+            // add() may change the resolution meanwhile, so recheck on wakeup
+            wheel_cond.wait_for(lock, std::chrono::microseconds(tick_start - current_time));
+            continue;
+        }
+
+        // entries of later wheel rounds share the slot and stay in it
+        slot_t due;
+        slot_t &slot = slots[current_tick % slots_count];
+        for (auto entry = slot.begin(); entry != slot.end();) {
+            if (entry->deadline / resolution <= current_tick)
+                due.splice(due.end(), slot, entry++);
+            else
+                ++entry;
+        }
+        entries_count -= due.size();
+        current_tick++;
+
+        if (due.empty())
+            continue;
+
+        std::vector<uint64_t> finished;
+        lock.unlock();
+        for (auto entry = due.begin(); entry != due.end();) {
+            if (entry->task()) {
+                ++entry;
+                continue;
+            }
+            if (entry->done) {
+                std::lock_guard<std::mutex> completion_lock(completion_mutex);
+                completions.push_back(std::move(entry->done));
+                completion_cond.notify_one();
+            }
+            finished.push_back(entry->interval);
+            entry = due.erase(entry);
+        }
+        current_time = now();
+        lock.lock();
+
+        while (!due.empty()) {
+            entry_t &entry = due.front();
+            entry.deadline += entry.interval;
+            if (entry.deadline <= current_time)
+                entry.deadline = current_time + entry.interval;
+            place(std::move(entry));
+            due.pop_front();
+        }
+
+        for (auto interval : finished)
+            intervals.erase(intervals.find(interval));
+        // the finest task is gone, no need to wake up that often anymore
+        if (!finished.empty() && !intervals.empty() && *intervals.begin() > resolution)
+            rebuild(*intervals.begin());
+    }
+}
+
+void monitor_scheduler_class::completion_body()
+{
+    std::unique_lock<std::mutex> lock(completion_mutex);
+
+    // the scheduler is stopped first, nothing is queued after that
+    while (!completions_closed || !completions.empty()) {
+        if (completions.empty()) {
+            completion_cond.wait(lock);
+            continue;
+        }
+        done_t done = std::move(completions.front());
+        completions.pop_front();
+        lock.unlock();
+        done();
+        lock.lock();
+    }
+}
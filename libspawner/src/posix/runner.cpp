@@ -1,15 +1,26 @@
 #include <iostream>
+#include <atomic>
+#include <mutex>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <pwd.h>
 #include <grp.h>
 #include <fcntl.h>
+#include <limits.h>
 
 #include "inc/error.h"
 #include "logger.h"
 
 #include "runner.h"
+#include "environment_block.h"
+
+#if defined(__linux__)
+#include <sched.h>
+
+static const size_t spawn_stack_size = 64 * 1024;
+#endif
 
 runner::runner (const std::string &program, const options_class &options)
     : base_runner(program, options)
@@ -24,60 +35,6 @@ process_status_t runner::get_process_status() {
     return process_status;
 }
 
-runner::env_vars_list_t runner::read_environment() const
-{
-    env_vars_list_t vars;
-    extern char **environ;
-    char *const *envp = environ;
-
-    while (*envp) {
-        std::string envStr(*envp++);
-        int pos = envStr.find("=");
-        vars.push_back(make_pair(envStr.substr(0, pos), envStr.substr(pos + 1)));
-    }
-
-    return vars;
-}
-
-char **runner::create_envp_for_process() const
-{
-    extern char **environ;
-    char **original;
-    char **result;
-
-    auto curr_vars = read_environment();
-    original = environ;
-
-    // environ variable is a shared resource
-    envp_mtx.lock();
-#ifdef __MACH__
-    // TODO: Find a real solution for OS X
-#else
-    environ = nullptr; //dont call clearenv() since it releases memory
-#endif
-    if (options.environmentMode == "user-default") {
-        PANIC("user-default mode is not supported");
-        //setenv("SPAWNER_VERSION", "POSIX", 1);
-    } else if (options.environmentMode == "clear") {
-        for (const auto& i : curr_vars)
-            // use unsetenv() or leave environ pointer with nullptr
-            setenv(i.first.c_str(), "" , 1);
-    } else if (options.environmentMode == "inherit") {
-        for (const auto& i : curr_vars)
-            setenv(i.first.c_str(), i.second.c_str(), 1);
-    }
-
-    for (const auto& i : options.environmentVars)
-        setenv(i.first.c_str(), i.second.c_str(), 1);
-
-    // restore original environ pointer
-    result = environ;
-    environ = original;
-    envp_mtx.unlock();
-
-    return result;
-}
-
 char **runner::create_argv_for_process() const
 {
     char **result, *argv_buff;
@@ -146,7 +103,8 @@ unsigned long long runner::get_current_time()
 {
     struct timespec ts;
 
-    if (clock_gettime(CLOCK_REALTIME, &ts) == -1) {
+    // steps of the system clock don't move deadlines
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == -1) {
         // XXX shut off process
         PANIC("get_current_time(): failed clock_gettime()");
     }
@@ -169,6 +127,125 @@ void runner::init_process(const char *cmd_toexec, char **process_argv, char **pr
     execve(cmd_toexec, process_argv, process_envp);
 }
 
+bool runner::init_spawned_child() {
+#if defined(__linux__)
+    return affinity.set(0);
+#else
+    return true;
+#endif
+}
+
+bool runner::restrict_spawned_child() {
+    return true;
+}
+
+bool runner::attaches_before_exec() const {
+    return false;
+}
+
+#if defined(__linux__)
+static void spawn_failed(int error_fd) {
+    int error = errno;
+    if (write(error_fd, &error, sizeof(error)) == -1) {
+        // the parent sees a child that died without exec anyway
+    }
+    _exit(EXIT_FAILURE);
+}
+
+int runner::spawn_child(void *arg) {
+    auto args = (spawn_args_t *)arg;
+
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+        // dup2() onto itself would leave the descriptor close-on-exec
+        if (args->stdio[fd] == fd ? fcntl(fd, F_SETFD, 0) == -1 : dup2(args->stdio[fd], fd) == -1)
+            spawn_failed(args->error_fd);
+    }
+    if (args->wd != nullptr && chdir(args->wd) == -1)
+        spawn_failed(args->error_fd);
+    if (!args->self->init_spawned_child())
+        spawn_failed(args->error_fd);
+
+    // keep only stdio and the error pipe, moved to the first free slot
+    const int error_fd = STDERR_FILENO + 1;
+    if (args->error_fd != error_fd) {
+        if (dup2(args->error_fd, error_fd) == -1 || fcntl(error_fd, F_SETFD, FD_CLOEXEC) == -1)
+            spawn_failed(args->error_fd);
+    }
+#if defined(SYS_close_range)
+    if (syscall(SYS_close_range, error_fd + 1, ~0U, 0) == -1)
+#endif
+    {
+        for (long fd = error_fd + 1, max_fd = sysconf(_SC_OPEN_MAX); fd < max_fd; fd++)
+            close(fd);
+    }
+
+    if (!args->self->restrict_spawned_child())
+        spawn_failed(error_fd);
+    sigprocmask(SIG_SETMASK, &args->mask, nullptr);
+    execve(args->cmd, args->argv, args->envp);
+    spawn_failed(error_fd);
+    return EXIT_FAILURE;
+}
+
+void runner::spawn_process(const char *cmd_toexec, const char *wd) {
+    auto environment = environment_block_class::get(options.environmentMode, options.environmentVars);
+
+    int error_pipe[2];
+    if (pipe2(error_pipe, O_CLOEXEC) == -1)
+        PANIC(strerror(errno));
+
+    auto stdinput = streams[std_stream_input]->get_pipe();
+    auto stdoutput = streams[std_stream_output]->get_pipe();
+    auto stderror = streams[std_stream_error]->get_pipe();
+
+    spawn_args_t args;
+    args.self = this;
+    args.cmd = cmd_toexec;
+    args.argv = create_argv_for_process();
+    args.envp = environment->data();
+    args.wd = wd;
+    args.stdio[STDIN_FILENO] = stdinput->get_input_handle();
+    args.stdio[STDOUT_FILENO] = stdoutput->get_output_handle();
+    args.stdio[STDERR_FILENO] = stderror->get_output_handle();
+    args.error_fd = error_pipe[1];
+
+    // The parent is suspended until the child calls execve() or exits.
+    // Signals stay blocked meanwhile, a handler must not run in the child.
+    std::vector<char> stack(spawn_stack_size);
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &args.mask);
+    proc_pid = clone(&runner::spawn_child, stack.data() + stack.size(), CLONE_VM | CLONE_VFORK | SIGCHLD, &args);
+    int clone_errno = errno;
+    pthread_sigmask(SIG_SETMASK, &args.mask, nullptr);
+
+    close(error_pipe[1]);
+    release_argv_for_process(args.argv);
+    if (proc_pid == -1) {
+        close(error_pipe[0]);
+        process_status = process_not_started;
+        PANIC(std::string("failed to clone(): ") + strerror(clone_errno));
+    }
+
+    stdinput->close(read_mode);
+    stdoutput->close(write_mode);
+    stderror->close(write_mode);
+
+    // execve() closes the pipe, anything read from it is the child's errno
+    int child_errno;
+    ssize_t len;
+    do {
+        len = read(error_pipe[0], &child_errno, sizeof(child_errno));
+    } while (len == -1 && errno == EINTR);
+    close(error_pipe[0]);
+    if (len == sizeof(child_errno)) {
+        waitpid(proc_pid, nullptr, 0);
+        process_status = process_not_started;
+        PANIC(std::string("failed to start child process: ") + strerror(child_errno));
+    }
+}
+#endif
+
 signal_t runner::get_signal() {
     if ((get_process_status() == process_finished_abnormally)
         || (get_process_status() == process_finished_terminated)) {
@@ -192,11 +269,57 @@ static bool wait_for_stopped(int pid) {
     return false;
 }
 
+bool runner::update_status(int status) {
+    if (WIFSIGNALED(status)) {
+        LOG("signaled", get_index());
+        // "signalled" means abnormal/terminate
+#ifdef WCOREDUMP
+        process_status = process_finished_abnormally;
+#else
+        process_status = process_finished_terminated;
+#endif
+
+        runner_signal = (signal_t)WTERMSIG(status);
+    } else if (WIFEXITED(status)) {
+        LOG("exited", get_index());
+        process_status = process_finished_normal;
+        exit_code = WEXITSTATUS(status);
+    } else if (WIFSTOPPED(status)) {
+        LOG("stopped", get_index());
+        process_status = process_suspended;
+        if (resume_requested) {
+            resume();
+        }
+    } else if (WIFCONTINUED(status)) {
+        LOG("continued", get_index());
+        resume_requested = false;
+        process_status = process_still_active;
+    }
+    return WIFEXITED(status) || WIFSIGNALED(status);
+}
+
+void runner::finish_wait(const struct rusage &usage) {
+    // get wall_clock time
+    report.user_time = get_time_since_create() / 10;
+
+    // of this child alone, reaped together with its status
+    ru = usage;
+    ru_success = true;
+
+    timeval t;
+    if (get_user_time(t))
+        ru.ru_utime = t;
+
+    {
+        std::lock_guard<std::mutex> lock(waitpid_cond_mtx);
+        waitpid_done = true;
+    }
+    waitpid_cond.notify_all();
+}
+
 void runner::waitpid_body() {
     int status;
 
-    runner_signal = signal_signal_no;
-    exit_code = 0;
     if (start_suspended) {
         if (!wait_for_stopped(proc_pid)) {
             PANIC(std::string("Failed to stop child process: ") + std::to_string(get_index()));
@@ -212,54 +335,34 @@ void runner::waitpid_body() {
     }
     waitpid_cond.notify_one();
 
+    struct rusage usage;
     do {
         status = 0;
-        pid_t w = waitpid(proc_pid, &status,
-            WUNTRACED | WCONTINUED);
-        if (WIFSIGNALED(status)) {
-            LOG("signaled", get_index());
-            // "signalled" means abnormal/terminate
-#ifdef WCOREDUMP
-            process_status = process_finished_abnormally;
-#else
-            process_status = process_finished_terminated;
-#endif
-
-            runner_signal = (signal_t)WTERMSIG(status);
-        } else if (WIFEXITED(status)) {
-            LOG("exited", get_index());
-            process_status = process_finished_normal;
-            exit_code = WEXITSTATUS(status);
-        } else if (WIFSTOPPED(status)) {
-            LOG("stopped", get_index());
-            process_status = process_suspended;
-            if (resume_requested) {
-                resume();
-            }
-        } else if (WIFCONTINUED(status)) {
-            LOG("continued", get_index());
-            resume_requested = false;
-            process_status = process_still_active;
-        }
-    } while (!WIFEXITED(status) && !WIFSIGNALED(status));
-    // get wall_clock time
-    report.user_time = get_time_since_create() / 10;
+        memset(&usage, 0, sizeof(usage));
+        pid_t w = wait4(proc_pid, &status,
+            WUNTRACED | WCONTINUED, &usage);
+    } while (!update_status(status));
 
-    if (getrusage(RUSAGE_CHILDREN, &ru) != -1) // TODO: not working with multiple runs
-        ru_success = true;
-
-#ifdef __linux__
-    timeval t = get_user_time();
-    ru.ru_utime.tv_sec = t.tv_sec;
-    ru.ru_utime.tv_usec = t.tv_usec;
-#endif
+    finish_wait(usage);
 }
 
 void runner::wait() {
     LOG("wait", get_index());
     if (waitpid_thread.joinable()) {
         waitpid_thread.join();
+    } else if (waitpid_watched) {
+        std::unique_lock<std::mutex> lock(waitpid_cond_mtx);
+        while (!waitpid_done)
+            waitpid_cond.wait(lock);
+    }
+#if defined(__linux__)
+    affinity.release();
+    // whatever the process left behind is killed by the reset
+    if (sandbox) {
+        sandbox_pool_class::instance().release(sandbox, options.sandbox_pool);
+        sandbox.reset();
     }
+#endif
     running = false;
 }
 
@@ -308,6 +411,19 @@ bool runner::is_running() {
 void runner::requisites() {
 #if defined(__linux__)
     affinity.set(proc_pid);
+#endif
+    runner_signal = signal_signal_no;
+    exit_code = 0;
+#if defined(__linux__)
+    // The child is blocked on child_sync, so it can't stop itself yet.
+    if (start_suspended)
+        process_status = process_suspended;
+    waitpid_watched = pidfd_watch_class::instance().watch(proc_pid, [this](int status, const struct rusage &usage) {
+        if (update_status(status))
+            finish_wait(usage);
+    });
+    if (waitpid_watched)
+        return;
 #endif
     // wait till waitpid body completely starts
     waitpid_thread = std::thread(&runner::waitpid_body, this);
@@ -316,7 +432,8 @@ void runner::requisites() {
         waitpid_cond.wait(lock);
 }
 
-timeval runner::get_user_time() {
+bool runner::get_user_time(timeval &time) {
+    return false;
 }
 
 void runner::report_login() {
@@ -379,11 +496,22 @@ int runner::change_credentials() {
     return 0;
 }
 
-void runner::create_process() {
-    char **argv, **envp;
-    char *cmd_toexec, *cwd = nullptr;
+std::string runner::resolve_program(const std::string &program)
+{
+    char *resolved = realpath(program.c_str(), nullptr);
+    if (resolved == nullptr)
+        PANIC("failed to realpath() for child program\n");
+    std::string result = resolved;
+    free(resolved);
 
     struct stat statbuf;
+    if (stat(result.c_str(), &statbuf) == -1 || !S_ISREG(statbuf.st_mode))
+        PANIC("please try not to exec a non regular file\n");
+    return result;
+}
+
+void runner::create_process() {
+    char **argv;
 
     if (options.debug)
         PANIC("debug is not supported");
@@ -404,59 +532,130 @@ void runner::create_process() {
     std::string run_program = program;
     report.working_directory = options.working_directory;
     const char *wd = (options.working_directory != "")?options.working_directory.c_str():nullptr;
-    cmd_toexec = realpath(run_program.c_str(), nullptr);
-    if (cmd_toexec == nullptr)
-        PANIC("failed to realpath() for child program\n");
+    const std::string cmd_path = resolved_program.empty() ? resolve_program(run_program) : resolved_program;
+    const char *cmd_toexec = cmd_path.c_str();
 
-    stat(cmd_toexec, &statbuf);
-    if (!S_ISREG(statbuf.st_mode))
-        PANIC("please try not to exec a non regular file\n");
+    if (options.spawn_engine != "fork" && options.spawn_engine != "vfork")
+        PANIC("unknown spawn engine " + options.spawn_engine);
+#if !defined(__linux__)
+    if (options.sandbox_pool > 0)
+        PANIC("namespace isolation is supported on Linux only");
+#else
+    if (!affinity.reserve(options.cpus, options.skip_smt_siblings))
+        PANIC("no usable cpu in --cpus=" + options.cpus);
+    LOG("cpu", affinity.get_cpu());
+
+    // the user namespace maps only the ids of the spawner
+    if (options.sandbox_pool > 0 && options.login != "")
+        PANIC("namespace isolation can't be combined with a login");
+    // joining a mount namespace resets the working directory to its root
+    std::string sandbox_wd;
+    if (options.sandbox_pool > 0 && (wd == nullptr || wd[0] != '/')) {
+        char current[PATH_MAX];
+        if (getcwd(current, sizeof(current)) == nullptr)
+            PANIC(strerror(errno));
+        sandbox_wd = wd == nullptr ? current : std::string(current) + "/" + wd;
+        wd = sandbox_wd.c_str();
+    }
 
-    // XXX move to secure runner and/or to forked child
-    if (wd != nullptr) {
-        cwd = getcwd(nullptr, 0);
-        if (cwd == nullptr)
-            PANIC("failed to getcwd()");
-        if (chdir(wd) == -1)
-            PANIC("failed to chdir() to specified working directory");
+    // The child of vfork can't stop itself before exec, the parent would
+    // wait for it forever, and can't resolve a login without allocating.
+    // Entering a pid namespace takes another child, which the fork path has.
+    if (options.spawn_engine == "vfork" && !start_suspended && options.login == "" && options.sandbox_pool == 0
+        && !attaches_before_exec()) {
+        spawn_process(cmd_toexec, wd);
+        vforked = true;
+
+        process_status = process_still_active;
+        running = true;
+        requisites();
+        return;
     }
+#endif
+
+    // environ is not touched, other threads may be creating processes too
+    auto environment = environment_block_class::get(options.environmentMode, options.environmentVars);
     argv = create_argv_for_process();
-    envp = create_envp_for_process();
 
-    std::string sem_name = "/spawner-sync-ch-" + std::to_string(getpid());
-    child_sync = sem_open(sem_name.c_str(), O_CREAT, O_RDWR, 0);
-    if (!child_sync) {
+    // one per child, processes may be created by several threads at once
+    static std::atomic<unsigned> sem_count(0);
+    std::string sem_name = "/spawner-sync-ch-" + std::to_string(getpid()) + "-" + std::to_string(sem_count++);
+    child_sync = sem_open(sem_name.c_str(), O_CREAT | O_EXCL, 0600, 0);
+    if (child_sync == SEM_FAILED) {
         PANIC(strerror(errno));
     }
+    // the child has it mapped after fork, the name is not needed any more
+    sem_unlink(sem_name.c_str());
 
     auto stdinput = streams[std_stream_input]->get_pipe();
     auto stdoutput = streams[std_stream_output]->get_pipe();
     auto stderror = streams[std_stream_error]->get_pipe();
 
+#if defined(__linux__)
+    // the child joins the namespaces and reports the pid of its own child,
+    // which is created in the pid namespace as a child of the spawner
+    int sandbox_pipe[2] = { -1, -1 };
+    if (options.sandbox_pool > 0) {
+        sandbox = sandbox_pool_class::instance().acquire(options.sandbox_pool);
+        if (pipe2(sandbox_pipe, O_CLOEXEC) == -1)
+            PANIC(strerror(errno));
+    }
+#endif
+
     proc_pid = fork();
     if (proc_pid == 0) { //child
-        //redirect stdin
-        close(STDIN_FILENO);
-        if (dup2(stdinput->get_input_handle(), STDIN_FILENO) == -1) {
-            PANIC(strerror(errno));
+#if defined(__linux__)
+        if (sandbox) {
+            if (!sandbox->enter())
+                PANIC(std::string("failed to enter namespaces: ") + strerror(errno));
+            pid_t pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+            if (pid == -1)
+                PANIC(strerror(errno));
+            if (pid > 0) {
+                _exit(write(sandbox_pipe[1], &pid, sizeof(pid)) == sizeof(pid) ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
         }
-        //redirect stdout
-        close(STDOUT_FILENO);
-        if (dup2(stdoutput->get_output_handle(), STDOUT_FILENO) == -1) {
-            PANIC(strerror(errno));
+#endif
+        //redirect stdin, stdout and stderr
+        const int stdio[] = {
+            stdinput->get_input_handle(), stdoutput->get_output_handle(), stderror->get_output_handle()
+        };
+        for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; fd++) {
+            // dup2() onto itself would leave the descriptor close-on-exec
+            if (stdio[fd] == fd ? fcntl(fd, F_SETFD, 0) == -1 : dup2(stdio[fd], fd) == -1) {
+                PANIC(strerror(errno));
+            }
         }
-        //redirect stderr
-        close(STDERR_FILENO);
-        if (dup2(stderror->get_output_handle(), STDERR_FILENO) == -1) {
-            PANIC(strerror(errno));
+        // only the child changes its directory, other threads of the
+        // spawner may open relative paths meanwhile
+        if (wd != nullptr && chdir(wd) == -1) {
+            PANIC("failed to chdir() to specified working directory");
         }
         //close all descriptors
 #ifdef __linux__
         procfd_class::close_all_pipes_without_std();
 #endif
 
-        init_process(cmd_toexec, argv, envp);
+        init_process(cmd_toexec, argv, environment->data());
+        _exit(EXIT_FAILURE);
     } else if (proc_pid > 0) { // parent
+#if defined(__linux__)
+        if (sandbox) {
+            close(sandbox_pipe[1]);
+            pid_t pid;
+            ssize_t len;
+            do {
+                len = read(sandbox_pipe[0], &pid, sizeof(pid));
+            } while (len == -1 && errno == EINTR);
+            close(sandbox_pipe[0]);
+            while (waitpid(proc_pid, nullptr, 0) == -1 && errno == EINTR);
+            if (len != sizeof(pid)) {
+                process_status = process_not_started;
+                PANIC("failed to start child process in namespaces");
+            }
+            proc_pid = pid;
+        }
+#endif
         stdinput->close(read_mode);
         stdoutput->close(write_mode);
         stderror->close(write_mode);
@@ -465,22 +664,14 @@ void runner::create_process() {
         PANIC("failed to fork()\n");
     }
 
-    if (wd != nullptr)
-        chdir(cwd);
-
     // move to runner_free routine
     release_argv_for_process(argv);
-    free(cmd_toexec);
-
-    if (cwd != nullptr)
-        free(cwd);
 
     process_status = process_still_active;
     running = true;
     requisites();
     sem_post(child_sync); //unlock child
     sem_close(child_sync);
-    sem_unlink(sem_name.c_str());
 }
 
 void runner::runner_free() {
@@ -509,6 +700,12 @@ report_class runner::get_report() {
         report.kernel_time = (10000000 * ru.ru_stime.tv_sec) / 10 + ru.ru_stime.tv_usec;
         report.processor_time = (10000000 * ru.ru_utime.tv_sec) / 10 + ru.ru_utime.tv_usec;
         report.load_ratio = report.user_time ? (double)report.processor_time / report.user_time : 1.0;
+        report.minor_faults = ru.ru_minflt;
+        report.major_faults = ru.ru_majflt;
+        report.voluntary_context_switches = ru.ru_nvcsw;
+        report.involuntary_context_switches = ru.ru_nivcsw;
+        report.block_input_ops = ru.ru_inblock;
+        report.block_output_ops = ru.ru_oublock;
         // "WallClock" (named "user_time") is filled in waitpid thread
 #if !defined(__linux__)
         report.peak_memory_used = ru.ru_maxrss * 1024;
@@ -518,6 +715,10 @@ report_class runner::get_report() {
     return report;
 }
 
+void runner::set_resolved_program(const std::string &path) {
+    resolved_program = path;
+}
+
 options_class runner::get_options() const {
     return options;
 }
@@ -1,9 +1,15 @@
 #include "securerunner.h"
 
+#include <atomic>
+
 #include <unistd.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 
 #include "rlimit.h"
 #include "error.h"
@@ -27,21 +33,97 @@ secure_runner::~secure_runner()
 }
 
 void secure_runner::create_process() {
+#if defined(__linux__)
+    // without hardware counters there is nothing to judge the limit by
+    if (check_restriction(restriction_instructions_limit) && !perf_counters_class::instructions_supported())
+        PANIC("instructions can't be counted on this host");
+    if (!options.cgroup_root.empty())
+        create_cgroup();
+    // the child only installs the program, errors are reported from here
+    if (check_restriction(restriction_security_limit)) {
+        if (!options.seccomp_profile.empty())
+            seccomp.load_profile(options.seccomp_profile);
+        seccomp.compile();
+    }
+#endif
     runner::create_process();
 }
 
+#if defined(__linux__)
+void secure_runner::create_cgroup() {
+    // indices repeat when several spawners share the process
+    static std::atomic<unsigned> cgroup_count(0);
+    std::string name = "sp-" + std::to_string(getpid()) + "-" + std::to_string(cgroup_count++);
+    if (!cgroup.create(options.cgroup_root, name))
+        PANIC("failed to create cgroup in " + options.cgroup_root + ": " + strerror(errno));
+
+    if (check_restriction(restriction_memory_limit)) {
+        if (!cgroup.set_memory_limit(get_restriction(restriction_memory_limit))) {
+            cgroup.destroy();
+            PANIC("failed to set memory.max, memory controller is not enabled in " + options.cgroup_root);
+        }
+        cgroup.watch_oom([this]() {
+            terminate_reason = terminate_reason_memory_limit;
+            process_status = process_finished_terminated;
+        });
+    }
+
+    if (check_restriction(restriction_processes_count_limit) &&
+        !cgroup.set_pids_limit(get_restriction(restriction_processes_count_limit))) {
+        cgroup.destroy();
+        PANIC("failed to set pids.max, pids controller is not enabled in " + options.cgroup_root);
+    }
+
+    // time limits are judged by the monitor, a cap on cpus is asked for explicitly
+    if (options.cgroup_cpus > 0 && !cgroup.set_cpu_limit(options.cgroup_cpus)) {
+        cgroup.destroy();
+        PANIC("failed to set cpu.max, cpu controller is not enabled in " + options.cgroup_root);
+    }
+}
+
+bool secure_runner::uses_perf_counters() const {
+    return options.perf_counters || check_restriction(restriction_instructions_limit);
+}
+#endif
+
 
 void secure_runner::init_process(const char *cmd_toexec, char **process_argv, char **process_envp) {
-    create_restrictions();
+    if (!create_restrictions())
+        _exit(EXIT_FAILURE);
     runner::init_process(cmd_toexec, process_argv, process_envp);
 }
 
+bool secure_runner::init_spawned_child() {
+#if defined(__linux__)
+    if (cgroup.is_active() && !cgroup.attach_self())
+        return false;
+#endif
+    return runner::init_spawned_child();
+}
+
+bool secure_runner::restrict_spawned_child() {
+    return create_restrictions();
+}
+
+bool secure_runner::attaches_before_exec() const {
+#if defined(__linux__)
+    // counters opened after exec() miss the start of the program
+    return uses_perf_counters();
+#else
+    return false;
+#endif
+}
+
 bool secure_runner::create_restrictions() {
     // XXX check return values and report to the parent
     if (check_restriction(restriction_memory_limit))
         // linux&cygwin both supports Address Space rlimit
 #if defined(__linux__)
-        impose_rlimit(RLIMIT_AS, 2*get_restriction(restriction_memory_limit));
+    {
+        // memory.max of the cgroup limits the resident size precisely
+        if (!cgroup.is_active())
+            impose_rlimit(RLIMIT_AS, 2*get_restriction(restriction_memory_limit));
+    }
 #elif defined(__CYGWIN__)
         impose_rlimit(RLIMIT_AS, get_restriction(restriction_memory_limit));
 #else
@@ -57,10 +139,8 @@ bool secure_runner::create_restrictions() {
     if (check_restriction(restriction_security_limit)) {
         impose_rlimit(RLIMIT_CORE, 0);
 #if defined(__linux__)
-        if (seccomp_probe_filter())
-            exit(EXIT_FAILURE);
-        else
-            seccomp_setup_filter();
+        if (!seccomp_filter_class::is_supported() || !seccomp.install())
+            return false;
 #endif // XXX warning for non linuxes
     }
 
@@ -71,21 +151,50 @@ bool secure_runner::create_restrictions() {
 void secure_runner::requisites() {
     creation_time = get_current_time();
 
-    monitor_thread = std::thread(&secure_runner::check_limits_proc, this);
-    // wait for monitor thread
-    std::unique_lock<std::mutex> lock(monitor_cond_mtx);
-    while (!monitor_ready)
-        monitor_cond.wait(lock);
+#if defined(__linux__)
+    // the child waits for child_sync, so it can't allocate anything yet,
+    // a child of the vfork engine has attached itself before exec
+    if (cgroup.is_active() && !vforked && !cgroup.attach(get_proc_pid())) {
+        kill(get_proc_pid(), SIGKILL);
+        cgroup.destroy();
+        PANIC("failed to move child process to " + cgroup.get_path() + ": " + strerror(errno));
+    }
+    // a child of the fork engine waits for child_sync before exec
+    if (uses_perf_counters())
+        perf.open(get_proc_pid(), !vforked);
+    // the limit would not be enforced otherwise
+    if (check_restriction(restriction_instructions_limit) && !perf.counts_instructions()) {
+        int error = errno;
+        kill(get_proc_pid(), SIGKILL);
+        while (waitpid(get_proc_pid(), nullptr, 0) == -1 && errno == EINTR);
+        cgroup.destroy();
+        PANIC(std::string("failed to count instructions of child process: ") + strerror(error));
+    }
+#endif
+
+    init_limits_proc();
+#if defined(__linux__)
+    start_deadline();
+#endif
+    monitor_added = true;
+    monitor_scheduler_class::instance().add(options.monitorInterval,
+        [this]() { return check_limits_proc(); },
+        [this]() { finish_limits_proc(); });
 
     runner::requisites();
 }
 
-timeval secure_runner::get_user_time() {
-    timeval a;
-    a.tv_sec = (int)proc_consumed;
-    a.tv_usec = (int)(1000000 * (proc_consumed - (int)proc_consumed));
-
-    return a;
+bool secure_runner::get_user_time(timeval &time) {
+#if defined(__linux__)
+    // cpu.stat also accounts for the children the process didn't wait for
+    uint64_t usage, user, system;
+    if (cgroup.is_active() && cgroup.read_cpu_usage(usage, user, system)) {
+        time.tv_sec = user / 1000000;
+        time.tv_usec = user % 1000000;
+        return true;
+    }
+#endif
+    return false;
 }
 
 report_class secure_runner::get_report() {
@@ -94,15 +203,28 @@ report_class secure_runner::get_report() {
 #if defined(__linux__)
     report.write_transfer_count = proc.discovered_io ? proc.write_bytes : 0;
     report.peak_memory_used = proc.discovered_stat ? proc.rss_max : 0;
+    report.sampled_peak_memory = true;
+    uint64_t memory_peak;
+    if (cgroup.is_active() && cgroup.read_memory_peak(memory_peak)) {
+        report.peak_memory_used = memory_peak;
+        report.sampled_peak_memory = false;
+    }
+    if (cgroup.is_active() && cgroup.read_oom_kills() > 0)
+        terminate_reason = report.terminate_reason = terminate_reason_memory_limit;
+    uint64_t instructions, task_clock;
+    if ((report.has_instructions = perf.read_instructions(instructions)))
+        report.instructions = instructions;
+    if ((report.has_task_clock = perf.read_task_clock(task_clock)))
+        report.task_clock = task_clock / 1000;
 #endif
     return runner::get_report();
 }
 
 void secure_runner::wait() {
     runner::wait();
-    if (monitor_thread.joinable()) {
-        monitor_thread.join();
-    }
+    std::unique_lock<std::mutex> lock(monitor_cond_mtx);
+    while (monitor_added && !monitor_done)
+        monitor_cond.wait(lock);
 }
 
 terminate_reason_t secure_runner::get_terminate_reason() {
@@ -131,7 +253,8 @@ terminate_reason_t secure_runner::get_terminate_reason() {
             || terminate_reason == terminate_reason_load_ratio_limit
             || terminate_reason == terminate_reason_time_limit
             || terminate_reason == terminate_reason_memory_limit
-            || terminate_reason == terminate_reason_by_controller)
+            || terminate_reason == terminate_reason_by_controller
+            || terminate_reason == terminate_reason_output_mismatch)
             break;
         else { // manually killed by a human or hard rlimit
             terminate_reason = terminate_reason_abnormal_exit_process;
@@ -145,9 +268,17 @@ terminate_reason_t secure_runner::get_terminate_reason() {
         terminate_reason = terminate_reason_abnormal_exit_process;
     }
 
+    if (terminate_reason == terminate_reason_not_terminated)
+        terminate_reason = requested_terminate_reason;
+
     return terminate_reason;
 }
 
+void secure_runner::terminate(terminate_reason_t reason) {
+    requested_terminate_reason = reason;
+    force_stop = true;
+}
+
 restrictions_class secure_runner::get_restrictions() const {
     return restrictions;
 }
@@ -174,193 +305,256 @@ void secure_runner::runner_free() {
     runner::runner_free();
 }
 
-void secure_runner::check_limits_proc() {
+void secure_runner::init_limits_proc() {
     // add SIGSTOP and getitimer() support
-    pid_t proc_pid;
-
-    struct timespec req;
-
     proc_pid = get_proc_pid();
+    kill_due = 0;
 
 #if defined(__linux__)
-    unsigned long long current_time;
-    double restriction; // TODO -- get rid of FPU calculations.
-
-    int tick_res = sysconf(_SC_CLK_TCK);
-    long ticks_elapsed = 0;
-    bool tick_detected = false;
-    long tick_to_micros = 1000000 / tick_res;
+    tick_res = sysconf(_SC_CLK_TCK);
+    ticks_elapsed = 0;
+    tick_detected = false;
+    tick_to_micros = 1000000 / tick_res;
+    current_time = 0;
 
     proc.probe_pid(proc_pid);
 
     proc.fill_all();
+    // a child of the fork engine is still a copy of the spawner here
+    if (!vforked)
+        proc.rss_max = proc.vss_max = 0;
 #endif
+}
 
-    req.tv_sec=0;
-    req.tv_nsec=0;
-
-    // tv_sec computation may be useless
-    if (options.monitorInterval >= 1000000)
-        req.tv_sec = (options.monitorInterval / 1000000);
-    // convert ms to ns
-    if (options.monitorInterval % 1000000)
-        req.tv_nsec = (options.monitorInterval % 1000000) * 1000;
-
-    // report back to main thread
-    {
-        std::lock_guard<std::mutex> lock(monitor_cond_mtx);
-        monitor_ready = true;
+bool secure_runner::check_limits_proc() {
+    if (!running)
+        return false;
+    if (kill_due && get_time_since_create() / 10 >= kill_due) {
+        kill(proc_pid, SIGKILL);
+        process_status = process_finished_terminated;
+        return false;
     }
-    monitor_cond.notify_one();
-
-    // Main loop..
-    while (running) {
 #if defined(__linux__)
-        if(!proc.fill_all())
-            break;
+    double restriction; // TODO -- get rid of FPU calculations.
 
-        if (force_stop) {
-            kill(proc_pid, SIGSTOP);
-            proc.fill_all();
-            kill(proc_pid, SIGKILL);
-            terminate_reason = terminate_reason_by_controller;
-            process_status = process_finished_terminated;
-            break;
-        }
+    if(!proc.fill_all())
+        return false;
+
+    if (force_stop) {
+        kill(proc_pid, SIGSTOP);
+        proc.fill_all();
+        kill(proc_pid, SIGKILL);
+        terminate_reason = requested_terminate_reason != terminate_reason_not_terminated
+            ? requested_terminate_reason : terminate_reason_by_controller;
+        process_status = process_finished_terminated;
+        return false;
+    }
 
-        if (check_restriction(restriction_write_limit) &&
-            (proc.write_bytes > get_restriction(restriction_write_limit))) {
-            // stop process and take a death mask
-            kill(proc_pid, SIGSTOP);
-            proc.fill_all();
-            // terminate
-            kill(proc_pid, SIGKILL);
-            terminate_reason = terminate_reason_write_limit;
-            process_status = process_finished_terminated;
-            break;
-        }
+    if (check_restriction(restriction_write_limit) &&
+        (proc.write_bytes > get_restriction(restriction_write_limit))) {
+        // stop process and take a death mask
+        kill(proc_pid, SIGSTOP);
+        proc.fill_all();
+        // terminate
+        kill(proc_pid, SIGKILL);
+        terminate_reason = terminate_reason_write_limit;
+        process_status = process_finished_terminated;
+        return false;
+    }
 
-        // The common virtual tick detection code (only for appropriate judges).
-        // -- Procfs utime entry is updated (only) when virtual "user space"
-        //    (The Linux kernel can be idle-tickless or even fully tickless,
-        //    so it provides virtual ticks for user space) "tick" ticks.
-        // -- Do not perform calculations too often (only after "tick" ticks).
-        if (check_restriction(restriction_idle_time_limit) ||
-            check_restriction(restriction_load_ratio) ||
-            check_restriction(restriction_processor_time_limit)
-        ) {
-            current_time = get_time_since_create() / 10;
-            if (tick_detected = (current_time / tick_to_micros > ticks_elapsed)) {
-                ticks_elapsed = current_time / tick_to_micros;
-            }
+    // The common virtual tick detection code (only for appropriate judges).
+    // -- Procfs utime entry is updated (only) when virtual "user space"
+    //    (The Linux kernel can be idle-tickless or even fully tickless,
+    //    so it provides virtual ticks for user space) "tick" ticks.
+    // -- Do not perform calculations too often (only after "tick" ticks).
+    if (check_restriction(restriction_idle_time_limit) ||
+        check_restriction(restriction_load_ratio) ||
+        check_restriction(restriction_processor_time_limit)
+    ) {
+        current_time = get_time_since_create() / 10;
+        if (tick_detected = (current_time / tick_to_micros > ticks_elapsed)) {
+            ticks_elapsed = current_time / tick_to_micros;
         }
+    }
 
-        if (check_restriction(restriction_memory_limit) &&
-            proc.rss_max > get_restriction(restriction_memory_limit)
-        ) {
-            terminate_reason = terminate_reason_memory_limit;
-            process_status = process_finished_terminated;
-            break;
-        }
+    // exceeding the instructions counts as exceeding the time limit
+    uint64_t instructions;
+    if (check_restriction(restriction_instructions_limit) && perf.read_instructions(instructions) &&
+        instructions > get_restriction(restriction_instructions_limit)) {
+        kill(proc_pid, SIGKILL);
+        terminate_reason = terminate_reason_time_limit;
+        process_status = process_finished_terminated;
+        return false;
+    }
+
+    // with a cgroup the kernel enforces memory.max on its own
+    if (check_restriction(restriction_memory_limit) && !cgroup.is_active() &&
+        proc.rss_max > get_restriction(restriction_memory_limit)
+    ) {
+        kill(proc_pid, SIGKILL);
+        terminate_reason = terminate_reason_memory_limit;
+        process_status = process_finished_terminated;
+        return false;
+    }
 
-        // The load ratio judge
-        // -- Calculate the ratio only when clock "ticks" at least first 5 times
-        //    (controlled process starts to consume CPU ticks after some time,
-        //    at least on my 1.4GHz Core2Solo), uncomment printfs and check with
-        //    "./sp --out /dev/null /bin/yes"
+    // The load ratio judge
+    // -- Calculate the ratio only when clock "ticks" at least first 5 times
+    //    (controlled process starts to consume CPU ticks after some time,
+    //    at least on my 1.4GHz Core2Solo), uncomment printfs and check with
+    //    "./sp --out /dev/null /bin/yes"
 #define TICK_THRESHOLD 5
 
+    // the cpu clock is exact, the tick count is the fallback for kernels
+    // which refuse to expose other processes' cpu clocks
+    if (proc.discovered_cpu_clock)
+        proc_consumed = (double)proc.cpu_time / 1000000000;
+    else
         proc_consumed = (double)proc.stat_utime / tick_res;
-        double wclk_elapsed = (double)current_time / 1000000;
-        double load_ratio = (proc_consumed - prev_consumed) / (wclk_elapsed - prev_elapsed);
+    double wclk_elapsed = (double)current_time / 1000000;
+    double load_ratio = (proc_consumed - prev_consumed) / (wclk_elapsed - prev_elapsed);
 
-        if (wclk_elapsed - prev_elapsed > 0.2) {
-            prev_consumed = proc_consumed;
-            prev_elapsed = wclk_elapsed;
-        }
+    if (wclk_elapsed - prev_elapsed > 0.2) {
+        prev_consumed = proc_consumed;
+        prev_elapsed = wclk_elapsed;
+    }
 
-        if (process_status != process_suspended &&
-            check_restriction(restriction_load_ratio) && tick_detected &&
-            check_restriction(restriction_idle_time_limit) &&
-            ticks_elapsed >= TICK_THRESHOLD
-        ) {
-            double idle_limit = get_restriction(restriction_idle_time_limit) / 1000000.0;
-            int step = (int)(idle_limit * options.monitorInterval / 10 / load_ratios_max_size);
-            if (ticks_elapsed % step == 0 && last_tick != ticks_elapsed) {
-                // printf("consumed: %g (procfs value %lu) ", proc_consumed, proc.stat_utime);
-                restriction = (double)get_restriction(restriction_load_ratio) / 10000;
-                // printf("load_ratio: %g, restriction: %g\n", load_ratio, restriction);
-                bool can_use_load_ratios = load_ratios.size() == load_ratios_max_size;
-                if (can_use_load_ratios) {
-                    load_ratios.pop_back();
-                    if (max_load_ratio_index == load_ratios_max_size - 1) {
-                        max_load_ratio_index = 0;
-                        for (int i = 1; i < load_ratios_max_size - 1; ++i) {
-                            if (load_ratios[max_load_ratio_index] < load_ratios[i]) {
-                                max_load_ratio_index = i;
-                            }
+    if (process_status != process_suspended &&
+        check_restriction(restriction_load_ratio) && tick_detected &&
+        check_restriction(restriction_idle_time_limit) &&
+        ticks_elapsed >= TICK_THRESHOLD
+    ) {
+        double idle_limit = get_restriction(restriction_idle_time_limit) / 1000000.0;
+        int step = (int)(idle_limit * options.monitorInterval / 10 / load_ratios_max_size);
+        if (ticks_elapsed % step == 0 && last_tick != ticks_elapsed) {
+            // printf("consumed: %g (procfs value %lu) ", proc_consumed, proc.stat_utime);
+            restriction = (double)get_restriction(restriction_load_ratio) / 10000;
+            // printf("load_ratio: %g, restriction: %g\n", load_ratio, restriction);
+            bool can_use_load_ratios = load_ratios.size() == load_ratios_max_size;
+            if (can_use_load_ratios) {
+                load_ratios.pop_back();
+                if (max_load_ratio_index == load_ratios_max_size - 1) {
+                    max_load_ratio_index = 0;
+                    for (int i = 1; i < load_ratios_max_size - 1; ++i) {
+                        if (load_ratios[max_load_ratio_index] < load_ratios[i]) {
+                            max_load_ratio_index = i;
                         }
                     }
                 }
-                load_ratios.push_front(load_ratio);
-                ++max_load_ratio_index;
-                if (load_ratios[max_load_ratio_index] <= load_ratio) {
-                    max_load_ratio_index = 0;
-                }
-                if (can_use_load_ratios &&
-                    load_ratios[max_load_ratio_index] < restriction
-                ) {
-                    kill(proc_pid, SIGSTOP);
-                    proc.fill_all();
-                    kill(proc_pid, SIGKILL);
-                    terminate_reason = terminate_reason_load_ratio_limit;
-                    process_status = process_finished_terminated;
-                    break;
-                }
             }
-            last_tick = ticks_elapsed;
-        }
-
-        // precise cpu usage judge
-        if (check_restriction(restriction_processor_time_limit) && tick_detected) {
-            double restriction = (double)get_restriction(restriction_processor_time_limit) / 1000000;
-            // printf("time limit: %g, utime: %lu, consumed: %g\n",
-            //    (double)restriction, proc.stat_utime, proc_consumed);
-            if (proc_consumed >= restriction) {
-                // stopped process has no chance to handle SIGXCPU
-                //kill(proc_pid, SIGSTOP);
+            load_ratios.push_front(load_ratio);
+            ++max_load_ratio_index;
+            if (load_ratios[max_load_ratio_index] <= load_ratio) {
+                max_load_ratio_index = 0;
+            }
+            if (can_use_load_ratios &&
+                load_ratios[max_load_ratio_index] < restriction
+            ) {
+                kill(proc_pid, SIGSTOP);
                 proc.fill_all();
-                // SIGXCPU can be ignored
-                kill(proc_pid, SIGXCPU);
-                // wait some time for signal delivery
-                usleep((useconds_t)tick_to_micros);
                 kill(proc_pid, SIGKILL);
-                terminate_reason = terminate_reason_time_limit;
+                terminate_reason = terminate_reason_load_ratio_limit;
                 process_status = process_finished_terminated;
+                return false;
+            }
+        }
+        last_tick = ticks_elapsed;
+    }
+
+    // precise cpu usage judge
+    if (check_restriction(restriction_processor_time_limit) &&
+        (tick_detected || proc.discovered_cpu_clock)) {
+        double restriction = (double)get_restriction(restriction_processor_time_limit) / 1000000;
+        // printf("time limit: %g, utime: %lu, consumed: %g\n",
+        //    (double)restriction, proc.stat_utime, proc_consumed);
+        if (proc_consumed >= restriction) {
+            // stopped process has no chance to handle SIGXCPU
+            //kill(proc_pid, SIGSTOP);
+            proc.fill_all();
+            if (deadline.is_active()) {
+                escalate(terminate_reason_time_limit);
+            } else {
+                defer_kill(terminate_reason_time_limit, tick_to_micros);
             }
         }
+    }
 
+    // the deadline timer takes care of the wall clock limit
+    if (deadline.is_active())
+        return true;
 #endif
-        if (check_restriction(restriction_user_time_limit) &&
-            (get_time_since_create() / 10) > get_restriction(restriction_user_time_limit)) {
+    if (check_restriction(restriction_user_time_limit) &&
+        (get_time_since_create() / 10) > get_restriction(restriction_user_time_limit)) {
 #if defined(__linux__)
-            proc.fill_all();
+        proc.fill_all();
 #endif
-            kill(proc_pid, SIGXCPU);
 #if defined(__linux__)
-            usleep((useconds_t)tick_to_micros);
+        defer_kill(terminate_reason_user_time_limit, tick_to_micros);
 #else
-            usleep(100 * 1000);
+        defer_kill(terminate_reason_user_time_limit, 100 * 1000);
 #endif
-            kill(proc_pid, SIGKILL);
-            terminate_reason = terminate_reason_user_time_limit;
-            process_status = process_finished_terminated;
-        }
+    }
+
+    return true;
+}
 
-        nanosleep(&req, nullptr);
+void secure_runner::defer_kill(terminate_reason_t reason, uint64_t grace) {
+    if (kill_due)
+        return;
+    terminate_reason = reason;
+    // SIGXCPU can be ignored
+    kill(proc_pid, SIGXCPU);
+    // sleeping here would hold up every other runner of the scheduler
+    kill_due = get_time_since_create() / 10 + grace;
+}
+
+#if defined(__linux__)
+void secure_runner::start_deadline() {
+    sigxcpu_sent = false;
+    // without a limit the timer is still of use for the grace of a cpu limit
+    if (!check_restriction(restriction_user_time_limit) && !check_restriction(restriction_processor_time_limit))
+        return;
+    if (!deadline.start([this]() { on_deadline(); }))
+        return;
+    // creation_time is in 100ns of CLOCK_MONOTONIC
+    if (check_restriction(restriction_user_time_limit) &&
+        !deadline.arm_at(creation_time * 100 + get_restriction(restriction_user_time_limit) * 1000))
+        deadline.stop();
+}
+
+void secure_runner::on_deadline() {
+    if (process_status != process_still_active && process_status != process_suspended)
+        return;
+    if (!sigxcpu_sent) {
+        escalate(terminate_reason_user_time_limit);
+        return;
     }
+    kill(proc_pid, SIGKILL);
+    process_status = process_finished_terminated;
+}
 
+void secure_runner::escalate(terminate_reason_t reason) {
+    // the monitor and the timer may both get here
+    if (sigxcpu_sent.exchange(true))
+        return;
+    terminate_reason = reason;
+    // SIGXCPU can be ignored
+    kill(proc_pid, SIGXCPU);
+    // some time for signal delivery
+    deadline.arm_after((uint64_t)tick_to_micros * 1000);
+}
+#endif
+
+void secure_runner::finish_limits_proc() {
+#if defined(__linux__)
+    deadline.stop();
+#endif
     if (on_terminate) {
         on_terminate();
     }
+
+    {
+        std::lock_guard<std::mutex> lock(monitor_cond_mtx);
+        monitor_done = true;
+    }
+    monitor_cond.notify_all();
 }
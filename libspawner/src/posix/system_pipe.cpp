@@ -1,10 +1,14 @@
 #include "system_pipe.h"
 
+#include <algorithm>
 #include <cstring>
 
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/file.h>
+#if defined(__linux__)
+#include <poll.h>
+#endif
 
 #include "error.h"
 #include "logger.h"
@@ -21,19 +25,19 @@ system_pipe_ptr system_pipe::open_std(std_stream_type type, bool flush) {
 
     switch (type) {
         case std_stream_input:
-            pipe->input_handle = dup(STDIN_FILENO);
+            pipe->input_handle = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
             if (pipe->input_handle == -1) {
                 PANIC(strerror(errno));
             }
             break;
         case std_stream_output:
-            pipe->output_handle = dup(STDOUT_FILENO);
+            pipe->output_handle = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
             if (pipe->output_handle == -1) {
                 PANIC(strerror(errno));
             }
             break;
         case std_stream_error:
-            pipe->output_handle = dup(STDOUT_FILENO);
+            pipe->output_handle = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
             if (pipe->output_handle == -1) {
                 PANIC(strerror(errno));
             }
@@ -47,9 +51,18 @@ system_pipe_ptr system_pipe::open_std(std_stream_type type, bool flush) {
 
 system_pipe_ptr system_pipe::open_pipe(pipe_mode mode, bool flush) {
     int pipefd[2];
+    // children get their ends through dup2(), nothing is inherited by chance
+#if defined(__linux__)
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        PANIC(strerror(errno));
+    }
+#else
     if (pipe(pipefd) < 0) {
         PANIC(strerror(errno));
     }
+    fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+#endif
 
     auto pipe = new system_pipe(flush);
     pipe->input_handle = pipefd[0];
@@ -58,17 +71,16 @@ system_pipe_ptr system_pipe::open_pipe(pipe_mode mode, bool flush) {
 }
 
 system_pipe_ptr system_pipe::open_file(const string& filename, pipe_mode mode, bool flush, bool excl) {
-    auto oflag = 0;
+    auto oflag = O_CLOEXEC;
     if (mode == read_mode) {
         oflag |= O_RDONLY | O_NOFOLLOW;
     } else if (mode == write_mode) {
-        oflag |= O_WRONLY | O_CREAT | O_NOFOLLOW,
-                S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH;
+        oflag |= O_WRONLY | O_CREAT | O_NOFOLLOW;
     } else
         PANIC("Bad pipe mode");
 
     int fd;
-    if ((fd = open(filename.c_str(), oflag)) < 0) {
+    if ((fd = open(filename.c_str(), oflag, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH)) < 0) {
         PANIC(filename + ": " + strerror(errno));
     }
     if (excl) {
@@ -85,6 +97,12 @@ system_pipe_ptr system_pipe::open_file(const string& filename, pipe_mode mode, b
     return system_pipe_ptr(pipe);
 }
 
+system_pipe_ptr system_pipe::adopt_file(pipe_handle handle) {
+    auto pipe = new system_pipe(false, pipe_type::file);
+    pipe->input_handle = handle;
+    return system_pipe_ptr(pipe);
+}
+
 pipe_handle system_pipe::get_input_handle() const {
     return input_handle;
 }
@@ -95,6 +113,8 @@ pipe_handle system_pipe::get_output_handle() const {
 
 system_pipe::~system_pipe() {
     close();
+    for (auto handle : tee_handles)
+        ::close(handle);
 }
 
 bool system_pipe::is_readable() const {
@@ -142,6 +162,148 @@ size_t system_pipe::write(const char* bytes, size_t count) {
     return (size_t)bytes_written;
 }
 
+size_t system_pipe::splice(const std::vector<system_pipe_ptr> &sinks, size_t count, bool &unsupported) {
+    unsupported = false;
+#if defined(__linux__)
+    std::lock_guard<mutex> lock(read_mutex);
+
+    if (!is_readable() || sinks.empty()) {
+        unsupported = true;
+        return 0;
+    }
+
+    // Wait for data here, so that sinks are not locked while the source is idle.
+    struct pollfd pfd = { input_handle, POLLIN, 0 };
+    while (poll(&pfd, 1, -1) == -1 && errno == EINTR);
+
+    if (sinks.size() == 1) {
+        auto sink = sinks.front().get();
+        ssize_t bytes_moved;
+        int error;
+        do {
+            sink->write_mutex.lock();
+            bytes_moved = -1;
+            error = EBADF;
+            if (sink->is_writable()) {
+                bytes_moved = ::splice(input_handle, nullptr, sink->output_handle, nullptr, count, SPLICE_F_MOVE);
+                error = errno;
+            }
+            sink->write_mutex.unlock();
+        } while (bytes_moved < 0 && error == EINTR);
+
+        if (bytes_moved < 0) {
+            // The sink is closed or can't be spliced into (e.g. O_APPEND),
+            // let write() deal with it.
+            if (error == EINVAL || error == EPIPE || error == EBADF) {
+                unsupported = true;
+                return 0;
+            }
+            PANIC(strerror(error));
+        }
+        LOG("spliced", bytes_moved);
+        if (bytes_moved > 0 && sink->autoflush)
+            sink->flush();
+        return (size_t)bytes_moved;
+    }
+
+    // tee() only duplicates what fits into the destination pipe and always
+    // starts from the head of the source, so every sink but the last one gets
+    // a private empty pipe as large as the source. The last sink consumes
+    // the data from the source itself.
+    size_t tees = sinks.size() - 1;
+    if (tee_handles.size() < 2 * tees) {
+        int capacity = fcntl(input_handle, F_GETPIPE_SZ);
+        if (capacity == -1) {
+            // tee() requires the source to be a pipe
+            unsupported = true;
+            return 0;
+        }
+        while (tee_handles.size() < 2 * tees) {
+            int pipefd[2];
+            if (pipe2(pipefd, O_CLOEXEC) < 0) {
+                PANIC(strerror(errno));
+            }
+            fcntl(pipefd[1], F_SETPIPE_SZ, capacity);
+            tee_handles.push_back(pipefd[0]);
+            tee_handles.push_back(pipefd[1]);
+        }
+    }
+
+    std::vector<size_t> teed(tees);
+    size_t length = count;
+    for (size_t i = 0; i < tees; i++) {
+        ssize_t bytes_teed;
+        do {
+            bytes_teed = ::tee(input_handle, tee_handles[2 * i + 1], length, 0);
+        } while (bytes_teed < 0 && errno == EINTR);
+        if (bytes_teed < 0) {
+            if (i == 0 && errno == EINVAL) {
+                unsupported = true;
+                return 0;
+            }
+            PANIC(strerror(errno));
+        }
+        teed[i] = (size_t)bytes_teed;
+        length = std::min(length, teed[i]);
+    }
+
+    for (size_t i = 0; i < tees; i++) {
+        transfer(tee_handles[2 * i], sinks[i].get(), length);
+        // drop whatever was duplicated beyond the common part
+        transfer(tee_handles[2 * i], nullptr, teed[i] - length);
+    }
+    transfer(input_handle, sinks[tees].get(), length);
+
+    LOG("teed", length);
+    return length;
+#else
+    unsupported = true;
+    return 0;
+#endif
+}
+
+void system_pipe::transfer(pipe_handle from, system_pipe *sink, size_t count) {
+    // Moves count bytes, which are already available in from, into the sink.
+    // Falls back to a copy through user space if the sink can't be spliced
+    // into, and drops the data if there is no sink or it is closed.
+#if defined(__linux__)
+    while (count > 0 && sink != nullptr) {
+        sink->write_mutex.lock();
+        ssize_t bytes_moved = -1;
+        int error = EBADF;
+        if (sink->is_writable()) {
+            bytes_moved = ::splice(from, nullptr, sink->output_handle, nullptr, count, SPLICE_F_MOVE);
+            error = errno;
+        }
+        sink->write_mutex.unlock();
+
+        if (bytes_moved > 0) {
+            count -= bytes_moved;
+            if (sink->autoflush)
+                sink->flush();
+        } else if (bytes_moved == 0) {
+            return;
+        } else if (error != EINTR) {
+            if (error != EINVAL)
+                sink = nullptr;
+            break;
+        }
+    }
+#endif
+
+    char buffer[4096];
+    while (count > 0) {
+        ssize_t bytes_read = ::read(from, buffer, std::min(count, sizeof(buffer)));
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read <= 0)
+            break;
+        if (sink != nullptr)
+            sink->write(buffer, bytes_read);
+        count -= bytes_read;
+    }
+}
+
 void system_pipe::flush() {
     write_mutex.lock();
     if (is_writable()) {
@@ -16,6 +16,7 @@ const restriction_cell restriction_identifiers[] = {
     {restriction_load_ratio          , "RESTRICTION_LOAD_RATIO"          , ""},
     {restriction_idle_time_limit     , "RESTRICTION_IDLE_TIME_LIMIT"     , ""},
     {restriction_processes_count_limit, "RESTRICTION_PROCESSES_COUNT_LIMIT", ""},
+    {restriction_instructions_limit  , "RESTRICTION_INSTRUCTIONS_LIMIT"  , ""},
     { restriction_max, "RESTRICTION_MAX", "" }
 };
 
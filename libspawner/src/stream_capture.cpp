@@ -0,0 +1,66 @@
+#include "stream_capture.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+stream_capture_class::stream_capture_class(size_t limit)
+    : limit(limit)
+    , ring(limit)
+{
+    head_data.reserve(limit);
+}
+
+void stream_capture_class::append(const char *bytes, size_t count)
+{
+    bytes_seen += count;
+
+    size_t to_head = std::min(count, limit - head_data.size());
+    head_data.append(bytes, to_head);
+    bytes += to_head;
+    count -= to_head;
+    if (count == 0)
+        return;
+
+    // only the last limit bytes can stay
+    if (count >= limit) {
+        memcpy(ring.data(), bytes + count - limit, limit);
+        ring_position = 0;
+        ring_filled = limit;
+        return;
+    }
+    size_t first = std::min(count, limit - ring_position);
+    memcpy(ring.data() + ring_position, bytes, first);
+    memcpy(ring.data(), bytes + first, count - first);
+    ring_position = (ring_position + count) % limit;
+    ring_filled = std::min(limit, ring_filled + count);
+}
+
+void stream_capture_class::finish()
+{
+    finished = true;
+}
+
+bool stream_capture_class::is_finished() const
+{
+    return finished;
+}
+
+uint64_t stream_capture_class::size() const
+{
+    return bytes_seen;
+}
+
+const std::string &stream_capture_class::head() const
+{
+    return head_data;
+}
+
+std::string stream_capture_class::tail() const
+{
+    if (ring_filled < limit)
+        return std::string(ring.data(), ring_filled);
+    std::string result(ring.data() + ring_position, limit - ring_position);
+    result.append(ring.data(), ring_position);
+    return result;
+}
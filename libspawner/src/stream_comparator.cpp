@@ -0,0 +1,208 @@
+#include "stream_comparator.h"
+
+#include <algorithm>
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "error.h"
+
+static bool is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static bool is_space(char c)
+{
+    return is_blank(c) || c == '\n';
+}
+
+stream_comparator_class::stream_comparator_class(const std::string &expected_file, compare_mode_t mode)
+    : mode(mode)
+{
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(expected_file.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        PANIC("can't open " + expected_file);
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        PANIC("can't open " + expected_file);
+    }
+    expected_size = (size_t)size.QuadPart;
+    if (expected_size > 0) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping != NULL)
+            expected = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+    CloseHandle(file);
+    if (expected_size > 0 && expected == nullptr)
+        PANIC("can't map " + expected_file);
+#else
+    int fd = open(expected_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        PANIC(expected_file + ": " + strerror(errno));
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        close(fd);
+        PANIC(expected_file + ": " + strerror(errno));
+    }
+    expected_size = file_stat.st_size;
+    // an empty file can't be mapped and doesn't have to be
+    if (expected_size > 0) {
+        void *address = mmap(nullptr, expected_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            close(fd);
+            PANIC(expected_file + ": " + strerror(errno));
+        }
+        madvise(address, expected_size, MADV_SEQUENTIAL);
+        expected = (const char *)address;
+    }
+    close(fd);
+#endif
+}
+
+stream_comparator_class::~stream_comparator_class()
+{
+#if defined(_WIN32)
+    if (expected != nullptr)
+        UnmapViewOfFile(expected);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+#else
+    if (expected != nullptr)
+        munmap((void *)expected, expected_size);
+#endif
+}
+
+void stream_comparator_class::on_mismatch(const mismatch_handler_t &handler)
+{
+    this->handler = handler;
+}
+
+void stream_comparator_class::feed(const char *bytes, size_t count)
+{
+    for (size_t i = 0; i < count && !failed;) {
+        // output repeating the answer byte for byte is the common case
+        if (!blank_diverged) {
+            size_t length = std::min(count - i, expected_size - position);
+            size_t matched = std::mismatch(bytes + i, bytes + i + length, expected + position).first - (bytes + i);
+            if (matched > 0) {
+                position += matched;
+                i += matched;
+                in_token = !is_space(bytes[i - 1]);
+                continue;
+            }
+        }
+        if (mode == compare_tokens)
+            feed_token_byte(bytes[i]);
+        else
+            feed_line_byte(bytes[i]);
+        i++;
+    }
+}
+
+void stream_comparator_class::finish()
+{
+    if (finished || failed)
+        return;
+    finished = true;
+
+    // the last token must have ended where the output did
+    if (mode == compare_tokens && in_token && !at_end() && !is_space(expected[position])) {
+        fail();
+        return;
+    }
+    while (!at_end() && is_space(expected[position]))
+        position++;
+    if (!at_end())
+        fail();
+}
+
+bool stream_comparator_class::mismatched() const
+{
+    return failed;
+}
+
+bool stream_comparator_class::at_end() const
+{
+    return position >= expected_size;
+}
+
+void stream_comparator_class::skip_blanks()
+{
+    while (!at_end() && is_blank(expected[position]))
+        position++;
+}
+
+void stream_comparator_class::fail()
+{
+    failed = true;
+    if (handler)
+        handler();
+}
+
+void stream_comparator_class::feed_token_byte(char c)
+{
+    if (is_space(c)) {
+        if (in_token && !at_end() && !is_space(expected[position])) {
+            fail();
+            return;
+        }
+        in_token = false;
+        return;
+    }
+
+    if (!in_token) {
+        while (!at_end() && is_space(expected[position]))
+            position++;
+        in_token = true;
+    }
+    if (at_end() || expected[position] != c) {
+        fail();
+        return;
+    }
+    position++;
+}
+
+void stream_comparator_class::feed_line_byte(char c)
+{
+    if (c == '\n') {
+        skip_blanks();
+        blank_diverged = false;
+        // past the end of the answer only empty lines may follow
+        if (at_end())
+            return;
+        if (expected[position] != '\n') {
+            fail();
+            return;
+        }
+        position++;
+        return;
+    }
+
+    if (is_blank(c)) {
+        // blanks that don't match are fine as long as the line ends here
+        if (blank_diverged || at_end() || expected[position] != c)
+            blank_diverged = true;
+        else
+            position++;
+        return;
+    }
+
+    if (blank_diverged || at_end() || expected[position] != c) {
+        fail();
+        return;
+    }
+    position++;
+}
@@ -0,0 +1,50 @@
+#include "stream_digest.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+stream_digest_class::stream_digest_class()
+{
+    md5_init(&md5_state);
+}
+
+void stream_digest_class::append(const char *bytes, size_t count)
+{
+    bytes_seen += count;
+    // md5_append() takes an int
+    while (count > 0) {
+        int chunk = (int)std::min(count, (size_t)std::numeric_limits<int>::max());
+        md5_append(&md5_state, (const md5_byte_t *)bytes, chunk);
+        bytes += chunk;
+        count -= chunk;
+    }
+}
+
+void stream_digest_class::finish()
+{
+    if (finished)
+        return;
+    md5_finish(&md5_state, digest);
+    finished = true;
+}
+
+bool stream_digest_class::is_finished() const
+{
+    return finished;
+}
+
+std::string stream_digest_class::hex() const
+{
+    std::ostringstream result;
+    for (int i = 0; i < 16; ++i) {
+        result << std::setfill('0') << std::setw(2) << std::hex << (int)digest[i];
+    }
+    return result.str();
+}
+
+uint64_t stream_digest_class::size() const
+{
+    return bytes_seen;
+}
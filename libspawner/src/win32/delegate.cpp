@@ -43,7 +43,8 @@ void delegate_runner::create_process() {
         { restriction_write_limit, "B" },
         { restriction_load_ratio, "" },
         { restriction_idle_time_limit, "us" },
-        { restriction_processes_count_limit, "" }
+        { restriction_processes_count_limit, "" },
+        { restriction_instructions_limit, "" }
     };
 
     const std::map< restriction_kind_t, std::string > cmd_arg = {
@@ -54,7 +55,8 @@ void delegate_runner::create_process() {
         { restriction_write_limit, "wl" },
         { restriction_load_ratio, "lr" },
         { restriction_idle_time_limit, "y" },
-        { restriction_processes_count_limit, "only-process" }
+        { restriction_processes_count_limit, "only-process" },
+        { restriction_instructions_limit, "il" }
     };
 
     for (int i = 0; i < restriction_max; ++i)
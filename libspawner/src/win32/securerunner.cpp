@@ -304,7 +304,8 @@ void secure_runner::wait()
             terminate = true;
             break;
         case JOB_OBJECT_MSG_PROCESS_CONTROLLER_STOP:
-            terminate_reason = terminate_reason_by_controller;
+            terminate_reason = requested_terminate_reason != terminate_reason_not_terminated
+                ? requested_terminate_reason : terminate_reason_by_controller;
             terminate = true;
             break;
         default:
@@ -383,6 +384,9 @@ report_class secure_runner::get_report() {
         report.peak_memory_used = xli.PeakJobMemoryUsed;
     }
 
+    if (terminate_reason == terminate_reason_not_terminated)
+        terminate_reason = requested_terminate_reason;
+
     return runner::get_report();
 }
 
@@ -402,3 +406,8 @@ process_status_t secure_runner::get_process_status()
 void secure_runner::prolong_time_limits() {
     prolong_time_limits_ = true;
 }
+
+void secure_runner::terminate(terminate_reason_t reason) {
+    requested_terminate_reason = reason;
+    force_stop = true;
+}
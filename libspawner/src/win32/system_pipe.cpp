@@ -98,6 +98,12 @@ system_pipe_ptr system_pipe::open_file(const string& filename, pipe_mode mode, b
     return system_pipe_ptr(pipe);
 }
 
+system_pipe_ptr system_pipe::adopt_file(pipe_handle handle) {
+    auto pipe = new system_pipe(false, pipe_type::file);
+    pipe->input_handle = handle;
+    return system_pipe_ptr(pipe);
+}
+
 pipe_handle system_pipe::get_input_handle() const {
     return input_handle;
 }
@@ -156,6 +162,15 @@ size_t system_pipe::write(const char* bytes, size_t count) {
     return bytes_written;
 }
 
+size_t system_pipe::splice(const std::vector<system_pipe_ptr> &sinks, size_t count, bool &unsupported) {
+    // Windows has no zero-copy transfer between pipe handles.
+    unsupported = true;
+    return 0;
+}
+
+void system_pipe::transfer(pipe_handle from, system_pipe *sink, size_t count) {
+}
+
 void system_pipe::flush() {
     flush_sem.notify();
 }
@@ -0,0 +1,236 @@
+#include "result_cache.h"
+
+#if !defined(_WIN32)
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include "inc/error.h"
+#include "inc/logger.h"
+
+static const char* REPORT_FILE = "report";
+static const char* OUTPUT_FILE = "stdout";
+static const char* ERROR_FILE = "stderr";
+
+static bool copy_file(const std::string& from, const std::string& to) {
+    int source = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    if (source == -1) {
+        return false;
+    }
+    int target = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
+    if (target == -1) {
+        close(source);
+        return false;
+    }
+    char buffer[65536];
+    bool result = true;
+    for (;;) {
+        ssize_t count = read(source, buffer, sizeof(buffer));
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            result = count == 0;
+            break;
+        }
+        for (ssize_t written = 0; written < count;) {
+            ssize_t len = write(target, buffer + written, count - written);
+            if (len == -1 && errno == EINTR) {
+                continue;
+            }
+            if (len <= 0) {
+                result = false;
+                break;
+            }
+            written += len;
+        }
+        if (!result) {
+            break;
+        }
+    }
+    close(source);
+    close(target);
+    return result;
+}
+
+static bool read_file(const std::string& path, std::string& contents) {
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file == -1) {
+        return false;
+    }
+    contents.clear();
+    char buffer[65536];
+    ssize_t count;
+    while ((count = read(file, buffer, sizeof(buffer))) != 0) {
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count == -1) {
+            close(file);
+            return false;
+        }
+        contents.append(buffer, count);
+    }
+    close(file);
+    return true;
+}
+
+static bool write_file(const std::string& path, const std::string& contents) {
+    int file = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IWUSR | S_IRUSR | S_IRGRP | S_IROTH);
+    if (file == -1) {
+        return false;
+    }
+    bool result = write(file, contents.data(), contents.size()) == (ssize_t)contents.size();
+    close(file);
+    return result;
+}
+
+// the entries hold files only
+static void remove_entry(const std::string& path) {
+    DIR* entry = opendir(path.c_str());
+    if (entry != nullptr) {
+        while (dirent* file = readdir(entry)) {
+            if (strcmp(file->d_name, ".") && strcmp(file->d_name, "..")) {
+                unlink((path + "/" + file->d_name).c_str());
+            }
+        }
+        closedir(entry);
+    }
+    rmdir(path.c_str());
+}
+
+result_cache_c::result_cache_c(const std::string& directory, uint64_t size_limit)
+    : directory(directory)
+    , size_limit(size_limit) {
+    if (mkdir(directory.c_str(), 0755) == -1 && errno != EEXIST) {
+        PANIC(directory + ": " + strerror(errno));
+    }
+}
+
+bool result_cache_c::restore(const std::string& key, const std::string& output_path, const std::string& error_path,
+    std::string& report) const {
+    std::string entry = directory + "/" + key;
+    if (!read_file(entry + "/" + REPORT_FILE, report)) {
+        return false;
+    }
+    if (output_path.length() && !copy_file(entry + "/" + OUTPUT_FILE, output_path)) {
+        return false;
+    }
+    if (error_path.length() && !copy_file(entry + "/" + ERROR_FILE, error_path)) {
+        return false;
+    }
+    // the modification time of an entry is the time it was last used
+    utimes(entry.c_str(), nullptr);
+    return true;
+}
+
+void result_cache_c::store(const std::string& key, const std::string& output_path, const std::string& error_path,
+    const std::string& report) const {
+    // the entry appears at once or not at all
+    static std::atomic<int> counter(0);
+    std::string temporary = directory + "/.tmp-" + std::to_string(getpid()) + "-" + std::to_string(counter++);
+    if (mkdir(temporary.c_str(), 0755) == -1) {
+        LOG("can't cache", temporary, strerror(errno));
+        return;
+    }
+    bool stored = write_file(temporary + "/" + REPORT_FILE, report)
+        && (output_path.empty() || copy_file(output_path, temporary + "/" + OUTPUT_FILE))
+        && (error_path.empty() || copy_file(error_path, temporary + "/" + ERROR_FILE))
+        && rename(temporary.c_str(), (directory + "/" + key).c_str()) == 0;
+    if (!stored) {
+        remove_entry(temporary);
+        return;
+    }
+    evict();
+}
+
+bool result_cache_c::append_file(stream_digest_class& key, const std::string& path) {
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file == -1) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == -1 || !S_ISREG(file_stat.st_mode)) {
+        close(file);
+        return false;
+    }
+    append_string(key, std::to_string(file_stat.st_size));
+    char buffer[65536];
+    ssize_t count;
+    while ((count = read(file, buffer, sizeof(buffer))) != 0) {
+        if (count == -1 && errno == EINTR) {
+            continue;
+        }
+        if (count == -1) {
+            close(file);
+            return false;
+        }
+        key.append(buffer, count);
+    }
+    close(file);
+    return true;
+}
+
+void result_cache_c::append_string(stream_digest_class& key, const std::string& value) {
+    std::string length = std::to_string(value.size()) + ":";
+    key.append(length.data(), length.size());
+    key.append(value.data(), value.size());
+}
+
+void result_cache_c::evict() const {
+    struct entry_t {
+        std::string path;
+        time_t used;
+        uint64_t size;
+    };
+    std::vector<entry_t> entries;
+    uint64_t total = 0;
+
+    DIR* cache = opendir(directory.c_str());
+    if (cache == nullptr) {
+        return;
+    }
+    while (dirent* item = readdir(cache)) {
+        // "." and "..", and entries still being stored
+        if (item->d_name[0] == '.') {
+            continue;
+        }
+        entry_t entry = { directory + "/" + item->d_name, 0, 0 };
+        struct stat entry_stat;
+        if (stat(entry.path.c_str(), &entry_stat) == -1 || !S_ISDIR(entry_stat.st_mode)) {
+            continue;
+        }
+        entry.used = entry_stat.st_mtime;
+        for (const char* name : { REPORT_FILE, OUTPUT_FILE, ERROR_FILE }) {
+            struct stat file_stat;
+            if (stat((entry.path + "/" + name).c_str(), &file_stat) == 0) {
+                entry.size += file_stat.st_size;
+            }
+        }
+        total += entry.size;
+        entries.push_back(entry);
+    }
+    closedir(cache);
+
+    if (total <= size_limit) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const entry_t& a, const entry_t& b) { return a.used < b.used; });
+    for (const auto& entry : entries) {
+        if (total <= size_limit) {
+            break;
+        }
+        remove_entry(entry.path);
+        total -= entry.size;
+    }
+}
+#endif
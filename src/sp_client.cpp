@@ -0,0 +1,70 @@
+// Client of a spawner started with --serve=<socket>. The arguments after
+// the socket are those of sp itself, the report printed is the one sp
+// would print. Relative paths are resolved by the server, in its own
+// working directory.
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static int fail(const std::string &what)
+{
+    fprintf(stderr, "sp-client: %s: %s\n", what.c_str(), strerror(errno));
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "Usage: sp-client <socket> <options> <executable> <executable arguments>\n");
+        return EXIT_FAILURE;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(argv[1]) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return fail(argv[1]);
+    }
+    strcpy(address.sun_path, argv[1]);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server == -1 || connect(server, (sockaddr *)&address, sizeof(address)) == -1)
+        return fail(argv[1]);
+
+    std::string request;
+    for (int i = 2; i < argc; i++) {
+        request.append(argv[i]);
+        request.push_back('\0');
+    }
+    for (size_t sent = 0; sent < request.size();) {
+        ssize_t count = write(server, request.data() + sent, request.size() - sent);
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            return fail("write");
+        sent += count;
+    }
+    shutdown(server, SHUT_WR);
+
+    char buffer[4096];
+    for (;;) {
+        ssize_t count = read(server, buffer, sizeof(buffer));
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count < 0)
+            return fail("read");
+        if (count == 0)
+            break;
+        fwrite(buffer, 1, count, stdout);
+    }
+    close(server);
+    return EXIT_SUCCESS;
+}
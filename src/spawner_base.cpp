@@ -1,5 +1,23 @@
 #include "spawner_base.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#if defined(_WIN32)
+const std::string spawner_base_c::null_device = "NUL";
+#else
+const std::string spawner_base_c::null_device = "/dev/null";
+#endif
+
 multipipe_ptr spawner_base_c::get_or_create_file_pipe(const std::string& path, pipe_mode mode, options_class::redirect_flags flags) {
     auto file_pipe = file_pipes.find(path);
     if (file_pipe == file_pipes.end()) {
@@ -36,6 +54,159 @@ multipipe_ptr spawner_base_c::get_std(std_stream_type type, options_class::redir
     return nullptr;
 }
 
+void spawner_base_c::start_std_read() {
+    if (spawner_stdin != nullptr) {
+        spawner_stdin->start_read();
+    }
+}
+
+multipipe_ptr spawner_base_c::open_direct_pipe(const std::string& path, std_stream_type type) {
+    return type == std_stream_input
+        ? multipipe::open_file(path, false, 0)
+        : multipipe::create_file(path, false, false, 0);
+}
+
+size_t spawner_base_c::parse_count(const std::string& value, const std::string& what, size_t min) {
+    char* value_end = nullptr;
+    unsigned long count = strtoul(value.c_str(), &value_end, 10);
+    if (value.empty() || *value_end != '\0' || count < min) {
+        PANIC("invalid number of " + what + " " + value);
+    }
+    return count;
+}
+
+std::function<multipipe_ptr()> spawner_base_c::buffer_input(const std::string& path) {
+#if defined(__linux__)
+    int file = open(path.c_str(), O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if (file == -1) {
+        PANIC(path + ": " + strerror(errno));
+    }
+    int copy = memfd_create("spawner-input", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (copy != -1) {
+        char buffer[65536];
+        ssize_t count;
+        while ((count = read(file, buffer, sizeof(buffer))) != 0) {
+            if (count == -1 && errno == EINTR) {
+                continue;
+            }
+            if (count == -1) {
+                PANIC(path + ": " + strerror(errno));
+            }
+            for (ssize_t written = 0; written < count;) {
+                ssize_t len = write(copy, buffer + written, count - written);
+                if (len == -1 && errno != EINTR) {
+                    PANIC("failed to buffer " + path + ": " + strerror(errno));
+                }
+                if (len > 0) {
+                    written += len;
+                }
+            }
+        }
+        close(file);
+        // the processes get a writable descriptor, they must not change
+        // the input of the runs after them
+        if (fcntl(copy, F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_GROW | F_SEAL_SHRINK | F_SEAL_SEAL) == -1) {
+            PANIC(strerror(errno));
+        }
+        std::shared_ptr<int> copy_handle(new int(copy), [](int* handle) {
+            close(*handle);
+            delete handle;
+        });
+        return [copy_handle]() {
+            // the duplicate shares the offset of the copy
+            lseek(*copy_handle, 0, SEEK_SET);
+            int handle = fcntl(*copy_handle, F_DUPFD_CLOEXEC, 0);
+            if (handle == -1) {
+                PANIC(strerror(errno));
+            }
+            return multipipe::adopt_file(handle, 0);
+        };
+    }
+    // kernels before 3.17, the page cache has to do
+    close(file);
+#endif
+    return [path]() { return open_direct_pipe(path, std_stream_input); };
+}
+
+run_statistics_t spawner_base_c::repeat_runs(const std::function<runner*()>& create_runner, size_t warmup, size_t repeat,
+    runner*& last) {
+    std::vector<report_class> reports;
+    last = nullptr;
+    for (size_t i = 0; i < warmup + repeat; i++) {
+        delete last;
+        last = nullptr;
+        last = create_runner();
+        last->set_index(i);
+        last->run_process_async();
+        if (!last->wait_for_init(1000)) {
+            PANIC("Failed to init process");
+        }
+        last->resume();
+        last->wait_for();
+        last->finalize();
+
+        const report_class report = last->get_report();
+        if (i >= warmup) {
+            reports.push_back(report);
+        }
+        if (report.terminate_reason != terminate_reason_not_terminated) {
+            break;
+        }
+    }
+    return summarize_runs(reports, warmup);
+}
+
+static sample_statistics_t summarize(std::vector<double> samples) {
+    sample_statistics_t statistics;
+    if (samples.empty()) {
+        return statistics;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t count = samples.size();
+    statistics.count = count;
+    statistics.min = samples.front();
+    statistics.max = samples.back();
+    statistics.median = count % 2 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+    // nearest rank
+    statistics.p95 = samples[(size_t)std::ceil(0.95 * count) - 1];
+    for (double sample : samples) {
+        statistics.total += sample;
+    }
+    statistics.mean = statistics.total / count;
+    if (count > 1) {
+        double squares = 0;
+        for (double sample : samples) {
+            squares += (sample - statistics.mean) * (sample - statistics.mean);
+        }
+        statistics.stddev = std::sqrt(squares / (count - 1));
+    }
+    return statistics;
+}
+
+run_statistics_t spawner_base_c::summarize_runs(const std::vector<report_class>& reports, size_t warmup) {
+    // the times come from wait4() of every run, the peak memory from a
+    // cgroup if there is one, from the samples of the monitor otherwise
+    std::vector<double> processor_time, user_time, peak_memory;
+    bool exact_peak_memory = true;
+    for (const auto& report : reports) {
+        processor_time.push_back((double)report.processor_time);
+        user_time.push_back((double)report.user_time);
+        exact_peak_memory = exact_peak_memory && !report.sampled_peak_memory;
+        // a run too short for the monitor to look at has no peak at all
+        if (!report.sampled_peak_memory || report.peak_memory_used > 0) {
+            peak_memory.push_back((double)report.peak_memory_used);
+        }
+    }
+    run_statistics_t statistics;
+    statistics.runs = reports.size();
+    statistics.warmup = warmup;
+    statistics.processor_time = summarize(processor_time);
+    statistics.user_time = summarize(user_time);
+    statistics.peak_memory = summarize(peak_memory);
+    statistics.peak_memory.exact = exact_peak_memory;
+    return statistics;
+}
+
 spawner_base_c::spawner_base_c()
     : spawner_stdin(nullptr)
     , spawner_stdout(nullptr)
@@ -1,9 +1,26 @@
 #include "spawner_new.h"
 
+#include <atomic>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 #include "inc/logger.h"
+#include "inc/stream_comparator.h"
+#include "result_cache.h"
 
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+extern char** environ;
+#endif
 
 spawner_new_c::spawner_new_c(settings_parser_c &parser)
     : parser(parser)
@@ -23,6 +40,44 @@ spawner_new_c::~spawner_new_c() {
     }
 }
 
+// Output of a process is UTF-8 at best; a2w() would stop at the first
+// zero byte and give up on anything the locale doesn't know. Invalid
+// sequences, including ones cut in two by a capture, become U+FFFD.
+static std::wstring decode_output(const std::string& bytes) {
+    std::wstring result;
+    result.reserve(bytes.size());
+    for (size_t i = 0; i < bytes.size();) {
+        unsigned char lead = bytes[i];
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xe ? 3 : (lead >> 3) == 0x1e ? 4 : 0;
+        uint32_t code_point = length == 1 ? lead : length == 2 ? lead & 0x1f : length == 3 ? lead & 0x0f : lead & 0x07;
+        bool valid = length > 0 && i + length <= bytes.size();
+        for (size_t j = 1; valid && j < length; j++) {
+            unsigned char next = bytes[i + j];
+            valid = (next >> 6) == 0x2;
+            code_point = (code_point << 6) | (next & 0x3f);
+        }
+        static const uint32_t shortest[] = { 0, 0, 0x80, 0x800, 0x10000 };
+        valid = valid && code_point >= shortest[length] && code_point <= 0x10ffff
+            && (code_point < 0xd800 || code_point > 0xdfff);
+        if (!valid) {
+            result.push_back((wchar_t)0xfffd);
+            i++;
+            continue;
+        }
+        // the writer takes UTF-16 whatever the size of wchar_t is
+        if (code_point >= 0x10000) {
+            code_point -= 0x10000;
+            result.push_back((wchar_t)(0xd800 | (code_point >> 10)));
+            result.push_back((wchar_t)(0xdc00 | (code_point & 0x3ff)));
+        }
+        else {
+            result.push_back((wchar_t)code_point);
+        }
+        i += length;
+    }
+    return result;
+}
+
 void spawner_new_c::json_report(runner *runner_instance,
     rapidjson::PrettyWriter<rapidjson::StringBuffer, rapidjson::UTF16<> > &writer) {
     writer.StartObject();
@@ -58,6 +113,7 @@ void spawner_new_c::json_report(runner *runner_instance,
         { "IOBytes", unit_memory_byte, degree_default, restriction_write_limit },
         { "IdlenessTime", unit_time_second, degree_micro, restriction_idle_time_limit },
         { "IdlenessProcessorLoad", unit_no_unit, degree_centi, restriction_load_ratio },
+        { "Instructions", unit_no_unit, degree_default, restriction_instructions_limit },
         { nullptr, unit_no_unit, degree_default, restriction_max },
     };
     for (int i = 0; restriction_items[i].field; ++i) {
@@ -98,8 +154,23 @@ void spawner_new_c::json_report(runner *runner_instance,
         { "BytesWritten", runner_report.write_transfer_count, unit_memory_byte, degree_default },
         { "KernelTime", runner_report.kernel_time, unit_time_second, degree_micro },
         { "ProcessorLoad", (uint64_t)(runner_report.load_ratio * 100), unit_no_unit, degree_micro },
+        { "MinorPageFaults", runner_report.minor_faults, unit_no_unit, degree_default },
+        { "MajorPageFaults", runner_report.major_faults, unit_no_unit, degree_default },
+        { "VoluntaryContextSwitches", runner_report.voluntary_context_switches, unit_no_unit, degree_default },
+        { "InvoluntaryContextSwitches", runner_report.involuntary_context_switches, unit_no_unit, degree_default },
+        { "BlockInputOperations", runner_report.block_input_ops, unit_no_unit, degree_default },
+        { "BlockOutputOperations", runner_report.block_output_ops, unit_no_unit, degree_default },
         { nullptr, 0, unit_no_unit, degree_default },
     };
+    const struct {
+        const char *field;
+        bool counted;
+        uint64_t value;
+        degrees_enum degree;
+    } perf_items[] = {
+        { "Instructions", runner_report.has_instructions, runner_report.instructions, degree_default },
+        { "TaskClock", runner_report.has_task_clock, runner_report.task_clock, degree_micro },
+    };
     for (int i = 0; result_items[i].field; ++i) {
         rapidjson_write(result_items[i].field);
         if (result_items[i].degree == degree_default) {
@@ -113,10 +184,70 @@ void spawner_new_c::json_report(runner *runner_instance,
             ));
         }
     }
+    for (const auto& item : perf_items) {
+        if (!item.counted) {
+            continue;
+        }
+        rapidjson_write(item.field);
+        if (item.degree == degree_default) {
+            writer.Uint64(item.value);
+        }
+        else {
+            writer.Double((double)convert(value_t(unit_time_second, item.degree), value_t(unit_time_second), (long double)item.value));
+        }
+    }
     rapidjson_write("WorkingDirectory");
     rapidjson_write(runner_report.working_directory.c_str());
     writer.EndObject();
 
+    if (statistics_.runs) {
+        rapidjson_write("Statistics");
+        writer.StartObject();
+        rapidjson_write("Runs");
+        writer.Uint64(statistics_.runs);
+        rapidjson_write("Warmup");
+        writer.Uint64(statistics_.warmup);
+        // in the units of Result
+        const struct {
+            const char *field;
+            const sample_statistics_t &samples;
+            double scale;
+        } statistics_items[] = {
+            { "Time", statistics_.processor_time, 1e-6 },
+            { "WallClockTime", statistics_.user_time, 1e-6 },
+            { "Memory", statistics_.peak_memory, 1 },
+        };
+        for (const auto& item : statistics_items) {
+            rapidjson_write(item.field);
+            writer.StartObject();
+            rapidjson_write("Samples");
+            writer.Uint64(item.samples.count);
+            rapidjson_write("Exact");
+            writer.Bool(item.samples.exact);
+            if (item.samples.count == 0) {
+                writer.EndObject();
+                continue;
+            }
+            const struct {
+                const char *field;
+                double value;
+            } values[] = {
+                { "Min", item.samples.min },
+                { "Max", item.samples.max },
+                { "Median", item.samples.median },
+                { "Mean", item.samples.mean },
+                { "StdDev", item.samples.stddev },
+                { "P95", item.samples.p95 },
+            };
+            for (const auto& value : values) {
+                rapidjson_write(value.field);
+                writer.Double(value.value * item.scale);
+            }
+            writer.EndObject();
+        }
+        writer.EndObject();
+    }
+
     rapidjson_write("StdOut");
     writer.StartArray();
     for (const auto& i : runner_options.stdoutput) {
@@ -135,6 +266,41 @@ void spawner_new_c::json_report(runner *runner_instance,
         rapidjson_write(i.original.c_str());
     }
     writer.EndArray();
+    const struct {
+        std_stream_type type;
+        const char* hash_name;
+        const char* capture_name;
+    } inspected_streams[] = {
+        { std_stream_output, "StdOutHash", "StdOutCapture" },
+        { std_stream_error, "StdErrHash", "StdErrCapture" },
+    };
+    for (const auto& stream : inspected_streams) {
+        auto key = std::make_pair(runner_instance->get_index(), stream.type);
+        auto digest = digests_.find(key);
+        if (digest != digests_.end() && digest->second->is_finished()) {
+            rapidjson_write(stream.hash_name);
+            writer.StartObject();
+            rapidjson_write("MD5");
+            rapidjson_write(digest->second->hex().c_str());
+            rapidjson_write("Size");
+            writer.Uint64(digest->second->size());
+            writer.EndObject();
+        }
+        auto capture = captures_.find(key);
+        if (capture != captures_.end() && capture->second->is_finished()) {
+            rapidjson_write(stream.capture_name);
+            writer.StartObject();
+            rapidjson_write("Size");
+            writer.Uint64(capture->second->size());
+            std::wstring head = decode_output(capture->second->head());
+            std::wstring tail = decode_output(capture->second->tail());
+            rapidjson_write("Head");
+            writer.String(head.data(), (rapidjson::SizeType)head.size());
+            rapidjson_write("Tail");
+            writer.String(tail.data(), (rapidjson::SizeType)tail.size());
+            writer.EndObject();
+        }
+    }
 
     rapidjson_write("CreateProcessMethod");
     rapidjson_write(options.login.empty() ? "CreateProcess" : "WithLogon");
@@ -287,6 +453,80 @@ void spawner_new_c::setup_stream_(const options_class::redirect redirect, std_st
         return;
     }
 
+    if (redirect.type == options_class::compare) {
+        if (source_type == std_stream_input) {
+            PANIC(redirect.original + ": only output can be compared");
+        }
+        // the delegated spawner compares the output itself
+        if (this_runner->get_options().login.length()) {
+            return;
+        }
+        auto mode = redirect.compare_lines
+            ? stream_comparator_class::compare_lines : stream_comparator_class::compare_tokens;
+        auto comparator = std::make_shared<stream_comparator_class>(redirect.name, mode);
+        comparator->on_mismatch([this_runner]() {
+            static_cast<secure_runner*>(this_runner)->terminate(terminate_reason_output_mismatch);
+        });
+        auto sink = multipipe::create_file(null_device);
+        sink->set_inspector([comparator](const char* buffer, size_t count) {
+            if (buffer == nullptr) {
+                comparator->finish();
+            }
+            else {
+                comparator->feed(buffer, count);
+            }
+        });
+        source_pipe->connect(sink);
+        inspected_pipes_.push_back(sink);
+        return;
+    }
+
+    if (redirect.type == options_class::hash) {
+        if (source_type == std_stream_input) {
+            PANIC(redirect.original + ": only output can be hashed");
+        }
+        if (this_runner->get_options().login.length()) {
+            return;
+        }
+        auto digest = std::make_shared<stream_digest_class>();
+        auto sink = multipipe::create_file(null_device);
+        sink->set_inspector([digest](const char* buffer, size_t count) {
+            if (buffer == nullptr) {
+                digest->finish();
+            }
+            else {
+                digest->append(buffer, count);
+            }
+        });
+        source_pipe->connect(sink);
+        inspected_pipes_.push_back(sink);
+        digests_[std::make_pair(this_runner->get_index(), source_type)] = digest;
+        return;
+    }
+
+    if (redirect.type == options_class::capture) {
+        if (source_type == std_stream_input) {
+            PANIC(redirect.original + ": only output can be captured");
+        }
+        if (this_runner->get_options().login.length()) {
+            return;
+        }
+        auto capture = std::make_shared<stream_capture_class>(redirect.capture_limit);
+        auto sink = multipipe::create_file(null_device);
+        sink->set_inspector([capture](const char* buffer, size_t count) {
+            if (buffer == nullptr) {
+                capture->finish();
+            }
+            else {
+                capture->append(buffer, count);
+            }
+        });
+        source_pipe->connect(sink);
+        inspected_pipes_.push_back(sink);
+        captures_[std::make_pair(this_runner->get_index(), source_type)] = capture;
+        return;
+    }
+
     PANIC_IF(redirect.type != options_class::pipe);
     auto index = redirect.pipe_index;
     auto stream = redirect.name;
@@ -324,10 +564,701 @@ void spawner_new_c::setup_stream_(const options_class::redirect redirect, std_st
     }
 }
 
+bool spawner_new_c::can_hand_off_(const runner* runner, const std::vector<options_class::redirect>& redirects,
+    std_stream_type type, const std::map<std::string, int>& file_users, const std::set<std::pair<int, std_stream_type>>& pipe_targets) const {
+#if defined(_WIN32)
+    return false;
+#else
+    // delegated runners pass their redirects on to another spawner
+    if (control_mode_enabled || runner->get_options().login.length()) {
+        return false;
+    }
+    // another runner reads or writes this stream
+    if (pipe_targets.count(std::make_pair(runner->get_index(), type))) {
+        return false;
+    }
+    if (redirects.empty()) {
+        return true;
+    }
+    if (redirects.size() > 1) {
+        return false;
+    }
+    const auto& redirect = redirects.front();
+    return redirect.type == options_class::file
+        && file_users.at(redirect.name) == 1
+        && !redirect.flags.flush
+        && !redirect.flags.exclusive;
+#endif
+}
+
+void spawner_new_c::init_streams_() {
+    std::map<std::string, int> file_users;
+    std::set<std::pair<int, std_stream_type>> pipe_targets;
+    for (auto runner : runners) {
+        options_class runner_options = runner->get_options();
+        for (const auto& redirects : { runner_options.stdinput, runner_options.stdoutput, runner_options.stderror }) {
+            for (const auto& redirect : redirects) {
+                if (redirect.type == options_class::file) {
+                    file_users[redirect.name]++;
+                }
+                else if (redirect.type == options_class::pipe) {
+                    std_stream_type target = redirect.name == "stdin" ? std_stream_input
+                        : redirect.name == "stdout" ? std_stream_output : std_stream_error;
+                    pipe_targets.insert(std::make_pair(redirect.pipe_index, target));
+                }
+            }
+        }
+    }
+
+    for (auto runner : runners) {
+        options_class runner_options = runner->get_options();
+        const struct {
+            std::vector<options_class::redirect> &streams;
+            std_stream_type type;
+        } redirects_all[] = {
+            { runner_options.stdinput, std_stream_input },
+            { runner_options.stdoutput, std_stream_output },
+            { runner_options.stderror, std_stream_error },
+        };
+        for (const auto& redirects : redirects_all) {
+            // A stream that goes to a single file or nowhere at all is given
+            // to the process as is, without a pipe and a thread relaying it.
+            if (can_hand_off_(runner, redirects.streams, redirects.type, file_users, pipe_targets)) {
+                const std::string& path = redirects.streams.empty() ? null_device : redirects.streams.front().name;
+                runner->set_pipe(redirects.type, open_direct_pipe(path, redirects.type));
+                continue;
+            }
+            auto pipe = runner->get_pipe(redirects.type);
+            for (const auto& redirect : redirects.streams) {
+                if (redirect.type != options_class::file) {
+                    continue;
+                }
+                if (redirects.type == std_stream_input) {
+                    get_or_create_file_pipe(redirect.name, read_mode, redirect.flags)->connect(pipe);
+                }
+                else {
+                    pipe->connect(get_or_create_file_pipe(redirect.name, write_mode, redirect.flags));
+                }
+            }
+        }
+    }
+}
+
+static bool apply_limit_override(restrictions_class& restrictions, const std::string& name, const std::string& value) {
+    if (name == "tl") {
+        microsecond_argument_parser_c(restrictions[restriction_processor_time_limit]).apply(value);
+    } else if (name == "d") {
+        microsecond_argument_parser_c(restrictions[restriction_user_time_limit]).apply(value);
+    } else if (name == "ml") {
+        byte_argument_parser_c(restrictions[restriction_memory_limit]).apply(value);
+    } else if (name == "wl") {
+        byte_argument_parser_c(restrictions[restriction_write_limit]).apply(value);
+    } else if (name == "y") {
+        microsecond_argument_parser_c(restrictions[restriction_idle_time_limit]).apply(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+std::vector<spawner_new_c::batch_case_t_> spawner_new_c::read_batch_manifest_(const restrictions_class& defaults) const {
+    std::ifstream manifest(batch_manifest_.c_str());
+    if (!manifest.is_open()) {
+        PANIC("failed to open batch manifest " + batch_manifest_);
+    }
+    // <stdin|-> <stdout|-> [-tl=<time>] [-d=<time>] [-ml=<size>] [-wl=<size>] [-y=<time>]
+    std::vector<batch_case_t_> batch;
+    std::string line;
+    for (size_t line_number = 1; std::getline(manifest, line); line_number++) {
+        const std::string location = batch_manifest_ + ":" + std::to_string(line_number) + ": ";
+        std::istringstream tokens(line);
+        batch_case_t_ batch_case;
+        if (!(tokens >> batch_case.input) || batch_case.input[0] == '#') {
+            continue;
+        }
+        if (!(tokens >> batch_case.output)) {
+            PANIC(location + "missing output file");
+        }
+        batch_case.restrictions = defaults;
+        std::string token;
+        while (tokens >> token) {
+            size_t divider = token.find('=');
+            if (token[0] != '-' || divider == std::string::npos) {
+                PANIC(location + "limits are given as -<name>=<value>, got " + token);
+            }
+            bool known = false;
+            try {
+                known = apply_limit_override(batch_case.restrictions, token.substr(1, divider - 1), token.substr(divider + 1));
+            } catch (std::string& error) {
+                PANIC(location + error);
+            }
+            if (!known) {
+                PANIC(location + "unknown limit " + token);
+            }
+        }
+        batch.push_back(batch_case);
+    }
+    return batch;
+}
+
+runner* spawner_new_c::create_batch_runner_(const batch_case_t_& batch_case, const std::string& program,
+    const std::string& resolved_program, const options_class& defaults) const {
+    options_class case_options(defaults);
+    case_options.stdinput.clear();
+    case_options.stdoutput.clear();
+    case_options.stderror.clear();
+    if (batch_case.input != "-") {
+        case_options.add_stdinput(batch_case.input);
+    }
+    if (batch_case.output != "-") {
+        case_options.add_stdoutput(batch_case.output);
+    }
+
+    runner* case_runner = new secure_runner(program, case_options, batch_case.restrictions);
+#if !defined(_WIN32)
+    case_runner->set_resolved_program(resolved_program);
+#endif
+    case_runner->set_pipe(std_stream_input, open_direct_pipe(
+        case_options.stdinput.empty() ? null_device : case_options.stdinput.front().name, std_stream_input));
+    case_runner->set_pipe(std_stream_output, open_direct_pipe(
+        case_options.stdoutput.empty() ? null_device : case_options.stdoutput.front().name, std_stream_output));
+    case_runner->set_pipe(std_stream_error, open_direct_pipe(null_device, std_stream_error));
+    return case_runner;
+}
+
+std::string spawner_new_c::resolve_program_(const std::string& program) const {
+#if defined(_WIN32)
+    return program;
+#else
+    return runner::resolve_program(program);
+#endif
+}
+
+size_t spawner_new_c::jobs_count_() const {
+    return parse_count(jobs_, "jobs", 1);
+}
+
+void spawner_new_c::run_batch_() {
+    // The runner made of the command line is only a template for the
+    // cases, it is never started.
+    const std::string program = runners.front()->get_program();
+    const options_class defaults = runners.front()->get_options();
+    const restrictions_class restrictions = runners.front()->get_restrictions();
+    delete runners.front();
+    runners.clear();
+
+    const size_t jobs = jobs_count_();
+    // every case runs the same file, it is looked up once per batch
+    const std::string resolved_program = resolve_program_(program);
+
+    const std::vector<batch_case_t_> batch = read_batch_manifest_(restrictions);
+
+    std::ofstream report_file;
+    if (defaults.report_file.length()) {
+        report_file.open(defaults.report_file.c_str());
+    }
+    // Reports are written as soon as a case is done, so the array can be
+    // consumed while the batch is still running.
+    auto write_report = [&](const std::string& report) {
+        if (!defaults.hide_report) {
+            *report_stream_ << report;
+            report_stream_->flush();
+        }
+        if (report_file.is_open()) {
+            report_file << report;
+            report_file.flush();
+        }
+    };
+
+    std::mutex report_mutex;
+    std::atomic<size_t> next_case(0);
+    bool first_report = true;
+    auto run_cases = [&]() {
+        for (size_t i = next_case++; i < batch.size(); i = next_case++) {
+            runner* case_runner = create_batch_runner_(batch[i], program, resolved_program, defaults);
+            case_runner->set_index(i);
+            case_runner->run_process_async();
+            if (!case_runner->wait_for_init(1000)) {
+                PANIC("Failed to init process");
+            }
+            case_runner->resume();
+            case_runner->wait_for();
+            case_runner->finalize();
+
+            rapidjson::StringBuffer s;
+            rapidjson::PrettyWriter<rapidjson::StringBuffer, rapidjson::UTF16<> > report_writer(s);
+            json_report(case_runner, report_writer);
+            delete case_runner;
+
+            std::lock_guard<std::mutex> lock(report_mutex);
+            write_report((first_report ? "\n" : ",\n") + std::string(s.GetString()));
+            first_report = false;
+        }
+    };
+
+    write_report("[");
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < jobs && i < batch.size(); i++) {
+        workers.push_back(std::thread(run_cases));
+    }
+    run_cases();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    write_report("\n]\n");
+}
+
+bool spawner_new_c::repeat_mode_() const {
+    return repeat_.length() || warmup_.length();
+}
+
+void spawner_new_c::run_repeat_() {
+    const size_t repeat = repeat_.length() ? parse_count(repeat_, "runs", 1) : 1;
+    const size_t warmup = warmup_.length() ? parse_count(warmup_, "warmup runs", 0) : 0;
+
+    // As in a batch every run gets a runner of its own, made after the
+    // one of the command line.
+    const std::string program = runners.front()->get_program();
+    const options_class repeat_options = runners.front()->get_options();
+    const restrictions_class restrictions = runners.front()->get_restrictions();
+    delete runners.front();
+    runners.clear();
+    const std::string resolved_program = resolve_program_(program);
+
+    // every run reads the same bytes from memory
+    const auto open_input = buffer_input(repeat_options.stdinput.empty()
+        ? null_device : repeat_options.stdinput.front().name);
+    const std::string output = repeat_options.stdoutput.empty()
+        ? null_device : repeat_options.stdoutput.front().name;
+    const std::string error = repeat_options.stderror.empty()
+        ? null_device : repeat_options.stderror.front().name;
+
+    begin_report();
+    runner* last_run = nullptr;
+    statistics_ = repeat_runs([&]() {
+        runner* run = new secure_runner(program, repeat_options, restrictions);
+#if !defined(_WIN32)
+        run->set_resolved_program(resolved_program);
+#endif
+        run->set_pipe(std_stream_input, open_input());
+        run->set_pipe(std_stream_output, open_direct_pipe(output, std_stream_output));
+        run->set_pipe(std_stream_error, open_direct_pipe(error, std_stream_error));
+        return run;
+    }, warmup, repeat, last_run);
+    // the last run is reported, with the statistics of all of them
+    runners.push_back(last_run);
+    print_report();
+}
+
+static void maybe_write_to_file(const std::string &file_name, const std::string &report) {
+    if (!file_name.length()) return;
+    std::ofstream fo(file_name.c_str());
+    fo << report;
+}
+
+#if !defined(_WIN32)
+std::string spawner_new_c::cache_key_() const {
+    // only a single program whose streams are all files, or nothing, can
+    // be replayed from the cache
+    if (cache_directory_.empty() || no_cache_ || runners.size() != 1 || batch_manifest_.length() || repeat_mode_()) {
+        return "";
+    }
+    runner* cached_runner = runners.front();
+    const options_class cached_options = cached_runner->get_options();
+    if (cached_options.controller || cached_options.login.length() || cached_options.delegated) {
+        return "";
+    }
+    for (const auto* redirects : { &cached_options.stdinput, &cached_options.stdoutput, &cached_options.stderror }) {
+        if (redirects->size() > 1 || (redirects->size() && redirects->front().type != options_class::file)) {
+            return "";
+        }
+    }
+
+    // Everything the outcome depends on. The redirects and the report
+    // format are there because the report shows them.
+    stream_digest_class key;
+    result_cache_c::append_string(key, "result 1");
+    const std::string program = cached_runner->get_program();
+    result_cache_c::append_string(key, program);
+    if (!result_cache_c::append_file(key, program)) {
+        return "";
+    }
+    for (size_t i = 0; i < cached_options.get_arguments_count(); ++i) {
+        result_cache_c::append_string(key, cached_options.get_argument(i));
+    }
+    result_cache_c::append_string(key, cached_options.environmentMode);
+    for (const auto& variable : cached_options.environmentVars) {
+        result_cache_c::append_string(key, variable.first);
+        result_cache_c::append_string(key, variable.second);
+    }
+    if (cached_options.environmentMode != "clear") {
+        for (char** variable = environ; *variable; ++variable) {
+            result_cache_c::append_string(key, *variable);
+        }
+    }
+    char directory[PATH_MAX];
+    result_cache_c::append_string(key, getcwd(directory, sizeof(directory)) ? directory : "");
+    result_cache_c::append_string(key, cached_options.working_directory);
+    if (cached_options.stdinput.empty()) {
+        result_cache_c::append_string(key, "");
+    }
+    else if (!result_cache_c::append_file(key, cached_options.stdinput.front().name)) {
+        return "";
+    }
+    for (const auto* redirects : { &cached_options.stdinput, &cached_options.stdoutput, &cached_options.stderror }) {
+        result_cache_c::append_string(key, redirects->empty() ? "" : redirects->front().original);
+    }
+    result_cache_c::append_string(key, cached_options.json ? "json" : "text");
+    if (!cached_options.seccomp_profile.empty() && !result_cache_c::append_file(key, cached_options.seccomp_profile)) {
+        return "";
+    }
+    result_cache_c::append_string(key, cached_options.sandbox_pool > 0 ? "isolated" : "");
+    // how the program is started and judged: the limits are enforced by a
+    // cgroup or by rlimits, the report has the counters or not
+    result_cache_c::append_string(key, cached_options.spawn_engine);
+    result_cache_c::append_string(key, cached_options.cgroup_root);
+    result_cache_c::append_string(key, std::to_string(cached_options.cgroup_cpus));
+    result_cache_c::append_string(key, cached_options.cpus);
+    result_cache_c::append_string(key, cached_options.skip_smt_siblings ? "cores" : "cpus");
+    result_cache_c::append_string(key, cached_options.perf_counters ? "perf" : "");
+    result_cache_c::append_string(key, std::to_string(cached_options.monitorInterval));
+    const restrictions_class cached_restrictions = cached_runner->get_restrictions();
+    for (int i = 0; i < restriction_max; ++i) {
+        result_cache_c::append_string(key, std::to_string(cached_restrictions.get_restriction((restriction_kind_t)i)));
+    }
+    key.finish();
+    return key.hex();
+}
+
+bool spawner_new_c::restore_cached_(const std::string& key) {
+    const options_class cached_options = runners.front()->get_options();
+    result_cache_c cache(cache_directory_, (uint64_t)parse_count(cache_limit_, "cache megabytes", 1) * 1024 * 1024);
+    std::string report;
+    if (!cache.restore(key,
+            cached_options.stdoutput.empty() ? "" : cached_options.stdoutput.front().name,
+            cached_options.stderror.empty() ? "" : cached_options.stderror.front().name,
+            report)) {
+        return false;
+    }
+    LOG("cache hit", key);
+    // the runner was never started, there is nothing to wait for
+    delete runners.front();
+    runners.clear();
+    // as print_report() would have done it
+    if (!cached_options.hide_report) {
+        *report_stream_ << report;
+    }
+    maybe_write_to_file(cached_options.report_file, report);
+    return true;
+}
+
+void spawner_new_c::store_cached_(const std::string& key) {
+    runner* cached_runner = runners.front();
+    report_class cached_report = cached_runner->get_report();
+    // limits depend on the load of the machine
+    bool deterministic = cached_report.terminate_reason == terminate_reason_not_terminated
+        || cached_report.terminate_reason == terminate_reason_abnormal_exit_process
+        || cached_report.terminate_reason == terminate_reason_output_mismatch;
+    if (!deterministic || cached_report.process_status == process_spawner_crash) {
+        return;
+    }
+    const options_class cached_options = cached_runner->get_options();
+    result_cache_c cache(cache_directory_, (uint64_t)parse_count(cache_limit_, "cache megabytes", 1) * 1024 * 1024);
+    cache.store(key,
+        cached_options.stdoutput.empty() ? "" : cached_options.stdoutput.front().name,
+        cached_options.stderror.empty() ? "" : cached_options.stderror.front().name,
+        render_report_(cached_runner));
+}
+#else
+std::string spawner_new_c::cache_key_() const {
+    if (cache_directory_.length() && !no_cache_) {
+        PANIC("--cache is not supported on Windows");
+    }
+    return "";
+}
+
+bool spawner_new_c::restore_cached_(const std::string& key) {
+    return false;
+}
+
+void spawner_new_c::store_cached_(const std::string& key) {
+}
+#endif
+
+#if !defined(_WIN32)
+static bool can_read_file(const std::string& path) {
+    return access(path.c_str(), R_OK) == 0;
+}
+
+static bool can_write_file(const std::string& path) {
+    if (access(path.c_str(), W_OK) == 0) {
+        return true;
+    }
+    if (errno != ENOENT) {
+        return false;
+    }
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    return access(directory.c_str(), W_OK) == 0;
+}
+
+std::string spawner_new_c::check_request_() const {
+    // Mistakes of the client are looked for before anything is started,
+    // whatever fails later makes the request panic.
+    int controllers = 0;
+    for (auto runner : runners) {
+        const options_class runner_options = runner->get_options();
+        if (runner_options.login.length()) {
+            return "-u is not supported by the server";
+        }
+        if (runner_options.controller && controllers++) {
+            return "there must be only one controller process";
+        }
+        struct stat file_stat;
+        const std::string program = runner->get_program();
+        if (stat(program.c_str(), &file_stat) == -1 || !S_ISREG(file_stat.st_mode)) {
+            return program + ": not a regular file";
+        }
+        const std::string& directory = runner_options.working_directory;
+        if (directory.length() && (stat(directory.c_str(), &file_stat) == -1 || !S_ISDIR(file_stat.st_mode))) {
+            return directory + ": not a directory";
+        }
+
+        const struct {
+            const std::vector<options_class::redirect> &streams;
+            std_stream_type type;
+        } redirects_all[] = {
+            { runner_options.stdinput, std_stream_input },
+            { runner_options.stdoutput, std_stream_output },
+            { runner_options.stderror, std_stream_error },
+        };
+        for (const auto& redirects : redirects_all) {
+            for (const auto& redirect : redirects.streams) {
+                if (redirect.type == options_class::std) {
+                    return redirect.original + ": the server has no standard streams to give";
+                }
+                if (redirect.type == options_class::file) {
+                    bool accessible = redirects.type == std_stream_input
+                        ? can_read_file(redirect.name) : can_write_file(redirect.name);
+                    if (!accessible) {
+                        return redirect.name + ": " + strerror(errno);
+                    }
+                    continue;
+                }
+                if (redirect.type == options_class::hash || redirect.type == options_class::capture) {
+                    if (redirects.type == std_stream_input) {
+                        return redirect.original + ": only output can be " +
+                            (redirect.type == options_class::hash ? "hashed" : "captured");
+                    }
+                    continue;
+                }
+                if (redirect.type == options_class::compare) {
+                    if (redirects.type == std_stream_input) {
+                        return redirect.original + ": only output can be compared";
+                    }
+                    if (!can_read_file(redirect.name)) {
+                        return redirect.name + ": " + strerror(errno);
+                    }
+                    continue;
+                }
+                bool input = redirects.type == std_stream_input;
+                bool known_stream = input ? redirect.name == "stdout" || redirect.name == "stderr" : redirect.name == "stdin";
+                if (redirect.pipe_index < 0 || redirect.pipe_index >= (int)runners.size() || !known_stream) {
+                    return redirect.original + ": no such stream";
+                }
+            }
+        }
+    }
+    return "";
+}
+
+std::string spawner_new_c::serve_request_(std::vector<std::string>& arguments) {
+    std::vector<char*> argv;
+    std::string spawner_program = "sp";
+    argv.push_back(&spawner_program[0]);
+    for (auto& argument : arguments) {
+        argv.push_back(&argument[0]);
+    }
+
+    settings_parser_c request_parser;
+    spawner_new_c request(request_parser);
+    std::ostringstream report;
+    request.report_stream_ = &report;
+    // what goes wrong from here on fails the request, not the server
+    throw_on_panic request_panics;
+    try {
+        {
+            // environment variables are read into a static buffer
+            static std::mutex parse_mutex;
+            std::lock_guard<std::mutex> lock(parse_mutex);
+            request.init_arguments();
+            if (!request_parser.parse(argv.size(), argv.data())) {
+                return "Error: invalid arguments\n";
+            }
+        }
+        // these may come from the environment the server was started in
+        request.serve_socket_.clear();
+        request.batch_manifest_.clear();
+        request.repeat_.clear();
+        request.warmup_.clear();
+
+        std::string error = !request.init_runner() || request.runners.empty() ? "no program given" : request.check_request_();
+        if (error.length()) {
+            // none of them has been started, there is nothing to wait for
+            for (auto runner : request.runners) {
+                delete runner;
+            }
+            request.runners.clear();
+            return "Error: " + error + "\n";
+        }
+        request.setup_runners_();
+        request.run();
+    } catch (const panic_error& error) {
+        // the runners started so far are stopped by their monitors and
+        // waited for with the request
+        for (auto runner : request.runners) {
+            static_cast<secure_runner*>(runner)->force_stop = true;
+        }
+        return "Error: " + std::string(error.what()) + "\n";
+    }
+    return report.str();
+}
+
+void spawner_new_c::serve_() {
+    const size_t jobs = jobs_count_();
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (serve_socket_.size() >= sizeof(address.sun_path)) {
+        PANIC(serve_socket_ + ": socket path is too long");
+    }
+    strcpy(address.sun_path, serve_socket_.c_str());
+
+    // a socket left behind by a previous server
+    struct stat socket_stat;
+    if (lstat(serve_socket_.c_str(), &socket_stat) == 0 && S_ISSOCK(socket_stat.st_mode)) {
+        unlink(serve_socket_.c_str());
+    }
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1 || fcntl(listener, F_SETFD, FD_CLOEXEC) == -1
+        || bind(listener, (sockaddr*)&address, sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1) {
+        PANIC(serve_socket_ + ": " + strerror(errno));
+    }
+
+    // A request is the command line of sp with arguments terminated by
+    // '\0', the client shuts its side down after the last one. The reply
+    // is what sp would print and the connection is closed after it.
+    static const size_t max_request_size = 1024 * 1024;
+    auto serve_connections = [&]() {
+        for (;;) {
+            int connection = accept(listener, nullptr, nullptr);
+            if (connection == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                PANIC(strerror(errno));
+            }
+            fcntl(connection, F_SETFD, FD_CLOEXEC);
+
+            std::string request;
+            char buffer[4096];
+            ssize_t count;
+            while (request.size() <= max_request_size && (count = read(connection, buffer, sizeof(buffer))) != 0) {
+                if (count > 0) {
+                    request.append(buffer, count);
+                } else if (errno != EINTR) {
+                    break;
+                }
+            }
+
+            std::string reply;
+            if (request.size() > max_request_size || request.empty() || request.back() != '\0') {
+                reply = "Error: malformed request\n";
+            } else {
+                std::vector<std::string> arguments;
+                for (size_t begin = 0, end; begin < request.size(); begin = end + 1) {
+                    end = request.find('\0', begin);
+                    arguments.push_back(request.substr(begin, end - begin));
+                }
+                reply = serve_request_(arguments);
+            }
+
+            for (size_t sent = 0; sent < reply.size();) {
+                count = send(connection, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+                if (count == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (count <= 0) {
+                    break;
+                }
+                sent += count;
+            }
+            close(connection);
+        }
+    };
+
+    LOG("serving", serve_socket_);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < jobs; i++) {
+        workers.push_back(std::thread(serve_connections));
+    }
+    serve_connections();
+}
+#else
+void spawner_new_c::serve_() {
+    PANIC("--serve is not supported on Windows");
+}
+#endif
+
 bool spawner_new_c::init() {
-    if (!init_runner() || !runners.size()) {
+    if (!init_runner()) {
+        return false;
+    }
+    if (serve_socket_.length()) {
+        // programs come with the requests
+        if (runners.size()) {
+            PANIC("the server does not take a program of its own");
+        }
+        return true;
+    }
+    if (!runners.size()) {
         return false;
     }
+    if (repeat_mode_()) {
+        if (runners.size() != 1 || batch_manifest_.length()) {
+            PANIC("repeat mode runs a single program");
+        }
+        const options_class repeat_options = runners.front()->get_options();
+        if (repeat_options.controller || repeat_options.login.length()) {
+            PANIC("repeat mode does not support --controller and -u");
+        }
+        // the streams of every run are opened anew, so only files will do
+        for (const auto* redirects : { &repeat_options.stdinput, &repeat_options.stdoutput, &repeat_options.stderror }) {
+            if (redirects->size() > 1 || (redirects->size() && redirects->front().type != options_class::file)) {
+                PANIC("repeat mode takes at most a single file per standard stream");
+            }
+        }
+        return true;
+    }
+    if (batch_manifest_.length()) {
+        // every case of a batch runs the one program of the command line
+        // with its own standard streams
+        if (runners.size() != 1) {
+            PANIC("batch mode runs a single program");
+        }
+        const options_class batch_options = runners.front()->get_options();
+        if (batch_options.controller || batch_options.login.length()) {
+            PANIC("batch mode does not support --controller and -u");
+        }
+        return true;
+    }
+    setup_runners_();
+    return true;
+}
+
+void spawner_new_c::setup_runners_() {
     for (size_t i = 0; i < runners.size(); i++) {
         if (runners[i]->get_options().controller) {
             // there must be only one controller process
@@ -383,6 +1314,8 @@ bool spawner_new_c::init() {
         }
     }
 
+    init_streams_();
+
     for (auto runner : runners) {
         options_class runner_options = runner->get_options();
         const struct {
@@ -403,7 +1336,6 @@ bool spawner_new_c::init() {
             }
         }
     }
-    return true;
 }
 
 bool spawner_new_c::init_runner() {
@@ -430,30 +1362,28 @@ bool spawner_new_c::init_runner() {
         secure_runner_instance = new secure_runner(parser.get_program(), options, restrictions);
     }
 
-    {//if (!options.session_id.length()) {
-        auto stdinput = secure_runner_instance->get_pipe(std_stream_input);
-        auto stdoutput = secure_runner_instance->get_pipe(std_stream_output);
-        auto stderror = secure_runner_instance->get_pipe(std_stream_error);
-
-        for (auto& input : options.stdinput)
-            if (input.type == options_class::file)
-                get_or_create_file_pipe(input.name, read_mode, input.flags)->connect(stdinput);
-
-        for (auto& output : options.stdoutput)
-            if (output.type == options_class::file)
-                stdoutput->connect(get_or_create_file_pipe(output.name, write_mode, output.flags));
-
-        for (auto& error : options.stderror)
-            if (error.type == options_class::file)
-                stderror->connect(get_or_create_file_pipe(error.name, write_mode, error.flags));
-    }
-
     secure_runner_instance->set_index(runners.size());
     runners.push_back(secure_runner_instance);
     return true;
 }
 
 void spawner_new_c::run() {
+    if (serve_socket_.length()) {
+        serve_();
+        return;
+    }
+    if (batch_manifest_.length()) {
+        run_batch_();
+        return;
+    }
+    if (repeat_mode_()) {
+        run_repeat_();
+        return;
+    }
+    const std::string cache_key = cache_key_();
+    if (cache_key.length() && restore_cached_(cache_key)) {
+        return;
+    }
     begin_report();
     LOG("initialize...");
     for (auto i : runners) {
@@ -467,6 +1397,7 @@ void spawner_new_c::run() {
     for (const auto& file_pipe : file_pipes) {
         file_pipe.second->start_read();
     }
+    start_std_read();
     for (auto i : runners) {
         i->get_pipe(std_stream_input)->check_parents();
     }
@@ -488,13 +1419,13 @@ void spawner_new_c::run() {
     for (const auto& file_pipe : file_pipes) {
         file_pipe.second->finalize();
     }
+    for (const auto& inspected_pipe : inspected_pipes_) {
+        inspected_pipe->finalize();
+    }
     print_report();
-}
-
-static void maybe_write_to_file(const std::string &file_name, const std::string &report) {
-    if (!file_name.length()) return;
-    std::ofstream fo(file_name.c_str());
-    fo << report;
+    if (cache_key.length()) {
+        store_cached_(cache_key);
+    }
 }
 
 void spawner_new_c::print_report() {
@@ -502,7 +1433,7 @@ void spawner_new_c::print_report() {
         std::string report = "Error: " + get_error_text();
         maybe_write_to_file(base_options.report_file, report);
         if (!base_options.hide_report)
-            std::cout << report;
+            *report_stream_ << report;
         return;
     }
     rapidjson::StringBuffer s;
@@ -523,22 +1454,7 @@ void spawner_new_c::print_report() {
 
             if (report.length() == 0)
             {
-                if (!options_item.json)
-                {
-                    report = GenerateSpawnerReport(
-                        rep, options_item,
-                        i->get_restrictions()
-                    );
-                }
-                else
-                {
-                    rapidjson::StringBuffer sub_report;
-                    rapidjson::PrettyWriter<rapidjson::StringBuffer, rapidjson::UTF16<> > report_item_writer(sub_report);
-                    report_item_writer.StartArray();
-                    json_report(i, report_item_writer);
-                    report_item_writer.EndArray();
-                    report = sub_report.GetString();
-                }
+                report = render_report_(i);
             }
 
             if (options_item.delegated)
@@ -549,7 +1465,7 @@ void spawner_new_c::print_report() {
             {
                 if (!options_item.hide_report && runners.size() == 1)
                 {
-                    std::cout << report;
+                    *report_stream_ << report;
                 }
                 maybe_write_to_file(options_item.report_file, report);
             }
@@ -560,11 +1476,24 @@ void spawner_new_c::print_report() {
         std::string report = s.GetString();
         maybe_write_to_file(base_options.report_file, report);
         if (!base_options.hide_report) {
-            std::cout << report;
+            *report_stream_ << report;
         }
     }
 }
 
+std::string spawner_new_c::render_report_(runner* runner_instance) {
+    options_class options_item = runner_instance->get_options();
+    if (!options_item.json) {
+        return GenerateSpawnerReport(runner_instance->get_report(), options_item, runner_instance->get_restrictions());
+    }
+    rapidjson::StringBuffer sub_report;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer, rapidjson::UTF16<> > report_item_writer(sub_report);
+    report_item_writer.StartArray();
+    json_report(runner_instance, report_item_writer);
+    report_item_writer.EndArray();
+    return sub_report.GetString();
+}
+
 void spawner_new_c::on_separator(const std::string &_) {
     init_runner();
     parser.clear_program_parser();
@@ -607,6 +1536,11 @@ void spawner_new_c::init_arguments() {
             new microsecond_argument_parser_c(restrictions[restriction_idle_time_limit]))
     )->set_description("Idleness time limit");
 
+    console_default_parser->add_argument_parser(c_lst(short_arg("il"), long_arg("instructions-limit")),
+        environment_default_parser->add_argument_parser(c_lst("SP_INSTRUCTIONS_LIMIT"),
+            new count_argument_parser_c(restrictions[restriction_instructions_limit]))
+    )->set_description("Instructions limit, counted by hardware counters and judged as the time limit (Linux)");
+
     console_default_parser->add_argument_parser(c_lst(short_arg("u")),
         environment_default_parser->add_argument_parser(c_lst("SP_USER"),
             new string_argument_parser_c(options.login))
@@ -665,6 +1599,65 @@ void spawner_new_c::init_arguments() {
         environment_default_parser->add_argument_parser(c_lst("SP_DEBUG"), new boolean_argument_parser_c(options.debug))
     );
 
+    console_default_parser->add_argument_parser(c_lst(long_arg("cgroup")),
+        environment_default_parser->add_argument_parser(c_lst("SP_CGROUP"), new string_argument_parser_c(options.cgroup_root))
+    )->set_description("Enforce limits with a leaf cgroup created in this delegated cgroup v2 directory");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("cgroup-cpus")),
+        environment_default_parser->add_argument_parser(c_lst("SP_CGROUP_CPUS"),
+            new options_callback_argument_parser_c(&options, &options_class::set_cgroup_cpus))
+    )->set_description("Let the cgroup use at most this many cpus at once via cpu.max, unlimited by default (Linux)");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("spawn-engine")),
+        environment_default_parser->add_argument_parser(c_lst("SP_SPAWN_ENGINE"), new string_argument_parser_c(options.spawn_engine))
+    )->set_description("Create processes with fork (default) or vfork, a faster clone(CLONE_VM | CLONE_VFORK) path for Linux");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("cpus")),
+        environment_default_parser->add_argument_parser(c_lst("SP_CPUS"), new string_argument_parser_c(options.cpus))
+    )->set_description("Give every process a free cpu of its own from this list, e.g. 0-3,8 (Linux)");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("skip-smt-siblings")),
+        environment_default_parser->add_argument_parser(c_lst("SP_SKIP_SMT_SIBLINGS"), new boolean_argument_parser_c(options.skip_smt_siblings))
+    )->set_description("Use one logical cpu of every physical core only");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("perf-counters")),
+        environment_default_parser->add_argument_parser(c_lst("SP_PERF_COUNTERS"), new boolean_argument_parser_c(options.perf_counters))
+    )->set_description("Report instructions and task clock counted by perf_event (Linux)");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("isolate")),
+        environment_default_parser->add_argument_parser(c_lst("SP_ISOLATE"),
+            new options_callback_argument_parser_c(&options, &options_class::set_sandbox_pool))
+    )->set_description("Run in user, pid, mount, net, ipc and uts namespaces, keeping this many sandboxes ready (Linux)");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("seccomp-profile")),
+        environment_default_parser->add_argument_parser(c_lst("SP_SECCOMP_PROFILE"), new string_argument_parser_c(options.seccomp_profile))
+    )->set_description("Also allow the syscalls of this profile under -s: \"<name|number> [arg<n> [& <mask>] ==|!= <value>]...\" per line (Linux)");
+
+    console_default_parser->add_argument_parser(c_lst(long_arg("batch")),
+        environment_default_parser->add_argument_parser(c_lst("SP_BATCH"), new string_argument_parser_c(batch_manifest_))
+    )->set_description("Run <executable> once for every line of this manifest: <stdin|-> <stdout|-> [-tl=..] [-d=..] [-ml=..] [-wl=..] [-y=..]");
+    console_default_parser->add_argument_parser(c_lst(long_arg("serve")),
+        environment_default_parser->add_argument_parser(c_lst("SP_SERVE"), new string_argument_parser_c(serve_socket_))
+    )->set_description("Stay resident and run the command lines sent by sp-client to this Unix socket");
+    console_default_parser->add_argument_parser(c_lst(long_arg("repeat")),
+        environment_default_parser->add_argument_parser(c_lst("SP_REPEAT"), new string_argument_parser_c(repeat_))
+    )->set_description("Run <executable> this many times on the same input and add statistics of all runs to the JSON report");
+    console_default_parser->add_argument_parser(c_lst(long_arg("warmup")),
+        environment_default_parser->add_argument_parser(c_lst("SP_WARMUP"), new string_argument_parser_c(warmup_))
+    )->set_description("Runs before those of --repeat which are not measured");
+    console_default_parser->add_argument_parser(c_lst(long_arg("cache")),
+        environment_default_parser->add_argument_parser(c_lst("SP_CACHE"), new string_argument_parser_c(cache_directory_))
+    )->set_description("Keep results of single program runs in this directory and replay them for the same program, arguments, environment, input and limits");
+    console_default_parser->add_argument_parser(c_lst(long_arg("cache-limit")),
+        environment_default_parser->add_argument_parser(c_lst("SP_CACHE_LIMIT"), new string_argument_parser_c(cache_limit_))
+    )->set_description("Megabytes the cache may take before the least recently used results go (default: 1024)");
+    console_default_parser->add_argument_parser(c_lst(long_arg("no-cache")),
+        environment_default_parser->add_argument_parser(c_lst("SP_NO_CACHE"), new boolean_argument_parser_c(no_cache_))
+    )->set_description("Run the program even if --cache is set");
+    console_default_parser->add_argument_parser(c_lst(long_arg("batch-jobs"), long_arg("jobs")),
+        environment_default_parser->add_argument_parser(c_lst("SP_BATCH_JOBS"), new string_argument_parser_c(jobs_))
+    )->set_description("Number of batch cases or served requests run at the same time (default: 1)");
+
     console_default_parser->add_argument_parser(c_lst(short_arg("mi"), long_arg("monitorInterval")),
         environment_default_parser->add_argument_parser(c_lst("SP_MONITOR_INTERVAL"),
             new microsecond_argument_parser_c(options.monitorInterval))
@@ -716,7 +1709,11 @@ std::string spawner_new_c::help() {
         "\t*e:file.txt   open file exclusively\n"
         "\t*fe:file.txt  many flags\n"
         "\t*fe:          set defaults for files\n"
-        "\t*:            reset defaults for files\n";
+        "\t*:            reset defaults for files\n"
+        "\t*cmp:ans.txt  compare tokens with ans.txt, stop at the first mismatch\n"
+        "\t*cmp-lines:ans.txt  the same line by line\n"
+        "\t*hash:        report MD5 and size of the output instead of keeping it\n"
+        "\t*capture:4096 report the first and the last 4096 bytes of the output\n";
     return
         "Spawner: cross-platform sandboxing utility\n"
         "Usage: sp <options> <executable> <executable arguments>\n\n"
@@ -1,5 +1,6 @@
 #include "spawner_pcms2.h"
 
+#include <cmath>
 #include <iostream>
 
 spawner_pcms2_c::spawner_pcms2_c(settings_parser_c &parser)
@@ -22,11 +23,52 @@ void spawner_pcms2_c::begin_report()
 bool spawner_pcms2_c::init()
 {
     options.hide_report = options.hide_output;
+    if (repeat.length() || warmup.length()) {
+        // the runners are made by run()
+        if (!parser.get_program().length()) {
+            return false;
+        }
+        if (options.login.length()) {
+            PANIC("--repeat does not support -l");
+        }
+        options.add_arguments(parser.get_program_arguments());
+        return true;
+    }
     return spawner_old_c::init();
 }
 
+void spawner_pcms2_c::run()
+{
+    if (!repeat.length() && !warmup.length()) {
+        spawner_old_c::run();
+        return;
+    }
+    const size_t runs = repeat.length() ? parse_count(repeat, "runs", 1) : 1;
+    const size_t warmup_runs = warmup.length() ? parse_count(warmup, "warmup runs", 0) : 0;
+
+    // every run reads the same bytes from memory
+    const auto open_input = buffer_input(input_file.length() ? input_file : null_device);
+    const std::string output = output_file.length() ? output_file : null_device;
+    const std::string error = error_file.length() ? error_file : null_device;
+
+    begin_report();
+    statistics = repeat_runs([&]() {
+        runner* run = new secure_runner(parser.get_program(), options, restrictions);
+        run->set_pipe(std_stream_input, open_input());
+        run->set_pipe(std_stream_output, open_direct_pipe(output, std_stream_output));
+        run->set_pipe(std_stream_error, open_direct_pipe(error, std_stream_error));
+        return run;
+    }, warmup_runs, runs, runner_instance);
+    print_report();
+}
+
 void spawner_pcms2_c::print_report()
 {
+    if (runner_instance == nullptr) {
+        // --repeat failed before the first run
+        std::cout << "Error: " << get_error_text() << std::endl;
+        return;
+    }
     report_class rep = runner_instance->get_report();
     options_class options = runner_instance->get_options();
     if (!options.hide_report) {
@@ -63,23 +105,26 @@ void spawner_pcms2_c::print_report()
 
     }
     if (options.report_file.length()) {
+        // a single run is a sample of its own
+        run_statistics_t runs = statistics.runs ? statistics : summarize_runs({ rep }, 0);
+        auto integer = [](double value) { return (unsigned long long)std::llround(value); };
         std::ofstream file(options.report_file);
-        file << "average.memoryConsumed=" << rep.peak_memory_used << std::endl;
-        file << "average.timeConsumed=" << rep.user_time << std::endl;
-        file << "average.timePassed=" << rep.processor_time << std::endl;
-        file << "invocations=1" << std::endl;
+        file << "average.memoryConsumed=" << integer(runs.peak_memory.mean) << std::endl;
+        file << "average.timeConsumed=" << integer(runs.user_time.mean) << std::endl;
+        file << "average.timePassed=" << integer(runs.processor_time.mean) << std::endl;
+        file << "invocations=" << runs.runs << std::endl;
         file << "last.memoryConsumed=" << rep.peak_memory_used << std::endl;
         file << "last.timeConsumed=" << rep.user_time << std::endl;
         file << "last.timePassed=" << rep.processor_time << std::endl;
-        file << "max.memoryConsumed=" << rep.peak_memory_used << std::endl;
-        file << "max.timeConsumed=" << rep.user_time << std::endl;
-        file << "max.timePassed=" << rep.processor_time << std::endl;
-        file << "min.memoryConsumed=" << rep.peak_memory_used << std::endl;
-        file << "min.timeConsumed=" << rep.user_time << std::endl;
-        file << "min.timePassed=" << rep.processor_time << std::endl;
-        file << "total.memoryConsumed=" << rep.peak_memory_used << std::endl;
-        file << "total.timeConsumed=" << rep.user_time << std::endl;
-        file << "total.timePassed=" << rep.processor_time << std::endl;
+        file << "max.memoryConsumed=" << integer(runs.peak_memory.max) << std::endl;
+        file << "max.timeConsumed=" << integer(runs.user_time.max) << std::endl;
+        file << "max.timePassed=" << integer(runs.processor_time.max) << std::endl;
+        file << "min.memoryConsumed=" << integer(runs.peak_memory.min) << std::endl;
+        file << "min.timeConsumed=" << integer(runs.user_time.min) << std::endl;
+        file << "min.timePassed=" << integer(runs.processor_time.min) << std::endl;
+        file << "total.memoryConsumed=" << integer(runs.peak_memory.total) << std::endl;
+        file << "total.timeConsumed=" << integer(runs.user_time.total) << std::endl;
+        file << "total.timePassed=" << integer(runs.processor_time.total) << std::endl;
         file.close();
     }
 }
@@ -122,6 +167,9 @@ Where options are:\n\
   -s <file>        - store statistics in then <file>\n\
   -D var=value     - sets value of the environment variable, current environment\n\
                      is completly ignored in this case #not implemented yet\n\
+  --repeat=<n>     - run the program <n> times on the same input, statistics\n\
+                     stored with -s are those of all runs\n\
+  --warmup=<n>     - run the program <n> more times before, not measured\n\
 Exteneded options:\n\
   -Xacp, --allow-create-processes #not implemented yet\n\
                    - allow the created process to create new processes\n\
@@ -158,6 +206,9 @@ void spawner_pcms2_c::init_arguments()
     console_default_parser->add_argument_parser(c_lst(short_arg("e")), new string_argument_parser_c(error_file));
     console_default_parser->add_argument_parser(c_lst(short_arg("i")), new string_argument_parser_c(input_file));
 
+    console_default_parser->add_argument_parser(c_lst(long_arg("repeat")), new string_argument_parser_c(repeat));
+    console_default_parser->add_argument_parser(c_lst(long_arg("warmup")), new string_argument_parser_c(warmup));
+
     console_default_parser->add_flag_parser(c_lst(short_arg("q")), new boolean_argument_parser_c(options.hide_output));
     console_default_parser->add_flag_parser(c_lst(short_arg("w")), new inverted_boolean_argument_parser_c(options.hide_gui));
 
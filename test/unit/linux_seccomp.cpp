@@ -0,0 +1,145 @@
+// Cases of seccomp_filter_class: every filter is installed in a child,
+// which makes a syscall and exits, the parent tells whether the syscall
+// was allowed by the way the child ended.
+//
+// usage: test_linux_seccomp
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include "error.h"
+#include "linux_seccomp.h"
+
+// what ctest takes for a skipped test
+static const int exit_skipped = 77;
+
+static int failures = 0;
+
+static std::string write_profile(const std::string &contents)
+{
+    char path[] = "/tmp/sp-test-profile-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1 || write(fd, contents.data(), contents.size()) != (ssize_t)contents.size()) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    return path;
+}
+
+static bool allowed(const seccomp_filter_class &filter, long nr, uint64_t arg0)
+{
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (!filter.install())
+            _exit(EXIT_FAILURE);
+        syscall(nr, arg0);
+        _exit(EXIT_SUCCESS);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) == -1);
+    if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS) {
+        fprintf(stderr, "the filter can't be installed\n");
+        exit(EXIT_FAILURE);
+    }
+    return WIFEXITED(status);
+}
+
+static void check(const char *name, const std::string &profile, long nr, uint64_t arg0, bool expected)
+{
+    std::string file = write_profile(profile);
+    seccomp_filter_class filter;
+    filter.load_profile(file);
+    filter.compile();
+    unlink(file.c_str());
+    if (allowed(filter, nr, arg0) != expected) {
+        fprintf(stderr, "%s: syscall %ld (%#llx) %s\n", name, nr, (unsigned long long)arg0,
+            expected ? "was killed" : "was allowed");
+        failures++;
+    }
+}
+
+static void check_rejected(const char *name, const std::string &profile)
+{
+    std::string file = write_profile(profile);
+    bool rejected = false;
+    {
+        throw_on_panic profile_panics;
+        try {
+            seccomp_filter_class filter;
+            filter.load_profile(file);
+        } catch (const panic_error &) {
+            rejected = true;
+        }
+    }
+    unlink(file.c_str());
+    if (!rejected) {
+        fprintf(stderr, "%s: the profile was accepted\n", name);
+        failures++;
+    }
+}
+
+int main()
+{
+    if (!seccomp_filter_class::is_supported()) {
+        fprintf(stderr, "seccomp filters are not supported\n");
+        return exit_skipped;
+    }
+
+    // umask() can't fail and takes an argument
+    const long nr = __NR_umask;
+    const uint64_t high = 1ULL << 32;
+
+    check("not listed", "", nr, 022, false);
+    check("built-in", "", __NR_getpid, 0, true);
+    check("unconditional", "umask\n", nr, 077, true);
+
+    check("==", "umask arg0 == 18\n", nr, 18, true);
+    check("== other value", "umask arg0 == 18\n", nr, 63, false);
+    check("== upper half", "umask arg0 == 18\n", nr, 18 | high, false);
+    check("!=", "umask arg0 != 18\n", nr, 63, true);
+    check("!= same value", "umask arg0 != 18\n", nr, 18, false);
+    check("!= upper half", "umask arg0 != 18\n", nr, 18 | high, true);
+    check("mask", "umask arg0 & 4 == 0\n", nr, 3, true);
+    check("mask set", "umask arg0 & 4 == 0\n", nr, 7, false);
+    check("mask upper half", "umask arg0 & 0x100000000 != 0\n", nr, 2 | high, true);
+    check("mask upper half clear", "umask arg0 & 0x100000000 != 0\n", nr, 2, false);
+    check("all checks", "umask arg0 & 4 == 0 arg0 != 2\n", nr, 2, false);
+    check("alternatives", "umask arg0 == 1\numask arg0 == 2 # comment\n", nr, 2, true);
+    check("alternatives, none holds", "umask arg0 == 1\numask arg0 == 2\n", nr, 3, false);
+
+    // Hundreds of syscalls and of alternatives of one: the jumps over
+    // subtrees and over the alternatives are longer than 255 instructions.
+    std::string large;
+    for (int i = 1000; i < 1400; i++)
+        large += std::to_string(i) + "\n";
+    for (int i = 100; i < 200; i++)
+        large += "umask arg0 == " + std::to_string(i) + "\n";
+    large += "umask arg0 == 18\n";
+    check("large: built-in", large, __NR_getpid, 0, true);
+    check("large: number", large, 1200, 0, true);
+    check("large: last number", large, 1399, 0, true);
+    check("large: not listed", large, 1400, 0, false);
+    check("large: first alternative", large, nr, 100, true);
+    check("large: last alternative", large, nr, 18, true);
+    check("large: no alternative", large, nr, 63, false);
+
+    check_rejected("unknown syscall", "no_such_syscall\n");
+    check_rejected("bad argument", "umask arg6 == 0\n");
+    check_rejected("bad operator", "umask arg0 < 1\n");
+    check_rejected("no value", "umask arg0 ==\n");
+    check_rejected("bad value", "umask arg0 == x\n");
+    check_rejected("bad mask", "umask arg0 & x == 0\n");
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+// Cases of stream_comparator_class: the output is fed in every possible
+// pair of chunks, so that tokens, lines and blanks get split between reads.
+//
+// usage: test_stream_comparator
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+#include "stream_comparator.h"
+
+static int failures = 0;
+
+static std::string write_expected(const std::string &contents)
+{
+    char path[] = "/tmp/sp-test-expected-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1 || write(fd, contents.data(), contents.size()) != (ssize_t)contents.size()) {
+        perror("mkstemp");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    return path;
+}
+
+// true if the output mismatched, split at the given offset
+static bool compare(const std::string &expected_file, stream_comparator_class::compare_mode_t mode,
+    const std::string &output, size_t split)
+{
+    stream_comparator_class comparator(expected_file, mode);
+    int reported = 0;
+    comparator.on_mismatch([&reported]() { reported++; });
+    comparator.feed(output.data(), split);
+    comparator.feed(output.data() + split, output.size() - split);
+    comparator.finish();
+    if (reported != (comparator.mismatched() ? 1 : 0)) {
+        fprintf(stderr, "the mismatch was reported %d times\n", reported);
+        failures++;
+    }
+    return comparator.mismatched();
+}
+
+static void check(const char *name, stream_comparator_class::compare_mode_t mode,
+    const std::string &expected, const std::string &output, bool match)
+{
+    std::string expected_file = write_expected(expected);
+    for (size_t split = 0; split <= output.size(); split++) {
+        if (compare(expected_file, mode, output, split) == match) {
+            fprintf(stderr, "%s: %s at split %zu\n", name, match ? "mismatched" : "matched", split);
+            failures++;
+            break;
+        }
+    }
+    unlink(expected_file.c_str());
+}
+
+int main()
+{
+    const auto tokens = stream_comparator_class::compare_tokens;
+    const auto lines = stream_comparator_class::compare_lines;
+
+    check("tokens: same", tokens, "1 2 3\n", "1 2 3\n", true);
+    check("tokens: other whitespace", tokens, "1 2\n3\n", "  1\t2 3", true);
+    check("tokens: trailing blanks", tokens, "1 2\n", "1 2   \n\n\n", true);
+    check("tokens: early eof", tokens, "1 2 3\n", "1 2", false);
+    check("tokens: early eof in a token", tokens, "12\n", "1", false);
+    check("tokens: longer token", tokens, "12\n", "123\n", false);
+    check("tokens: split token", tokens, "12\n", "1 2\n", false);
+    check("tokens: extra token", tokens, "1 2\n", "1 2 3\n", false);
+    check("tokens: extra output without newline", tokens, "1 2", "1 2x", false);
+    check("tokens: wrong token", tokens, "hello world\n", "hello word\n", false);
+    check("tokens: empty answer", tokens, "", " \n", true);
+    check("tokens: empty answer, extra output", tokens, "", "1", false);
+
+    check("lines: same", lines, "a b\nc\n", "a b\nc\n", true);
+    check("lines: trailing blanks", lines, "a b\nc\n", "a b  \nc\t\n", true);
+    check("lines: trailing empty lines", lines, "a\n", "a\n\n\n", true);
+    check("lines: no final newline", lines, "a\nb\n", "a\nb", true);
+    check("lines: early eof", lines, "a\nb\n", "a\n", false);
+    check("lines: early eof in a line", lines, "abc\n", "ab", false);
+    check("lines: extra line", lines, "a\n", "a\nb\n", false);
+    check("lines: extra output in a line", lines, "a\n", "ab\n", false);
+    check("lines: blanks inside a line", lines, "a b\n", "a  b\n", false);
+    check("lines: lines joined", lines, "a\nb\n", "a b\n", false);
+    check("lines: blank then text", lines, "a\n", "a \tb\n", false);
+
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}